@@ -0,0 +1,67 @@
+// Example Includes
+#include "BufferPool.hpp"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// C++ includes
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+/// Alignment of all the buffers (one cache line)
+static const size_t CACHE_LINE_BYTES = 64;
+
+/// Size of a transparent huge page; buffers smaller than this keep regular pages
+static const size_t HUGE_PAGE_BYTES = 2 * 1024 * 1024;
+
+BufferPool::BufferPool( size_t nslots ) : mBuffers( nslots ) {}
+
+BufferPool::~BufferPool()
+{
+    for( auto& buffer : mBuffers )
+        release( buffer );
+}
+
+void BufferPool::reserve( size_t slot, size_t count )
+{
+    Buffer& buffer = mBuffers[slot];
+    if( count > buffer.capacity ) grow( buffer, count );
+}
+
+void BufferPool::grow( Buffer& buffer, size_t count )
+{
+    release( buffer );
+
+    // Huge-page backed buffers are aligned and rounded to whole huge pages so that the kernel can
+    // map them with 2 MB pages; the other buffers are aligned to a cache line
+    size_t bytes       = count * sizeof( double );
+    const bool huge    = mHugePages && bytes >= HUGE_PAGE_BYTES;
+    const size_t align = huge ? HUGE_PAGE_BYTES : CACHE_LINE_BYTES;
+    bytes              = ( bytes + align - 1 ) / align * align;
+    void* data         = nullptr;
+    if( posix_memalign( &data, align, bytes ) != 0 ) throw std::bad_alloc();
+#if defined( __linux__ ) && defined( MADV_HUGEPAGE )
+    buffer.huge = huge && madvise( data, bytes, MADV_HUGEPAGE ) == 0;
+#else
+    buffer.huge = false;
+#endif
+
+    buffer.data     = static_cast< double* >( data );
+    buffer.capacity = bytes / sizeof( double );
+    buffer.bytes    = bytes;
+    // first touch by the thread that runs the exchanges, before any MPI library access
+    std::fill( buffer.data, buffer.data + buffer.capacity, 0.0 );
+    mStatistics.bytes += bytes;
+    if( buffer.huge ) mStatistics.huge_bytes += bytes;
+}
+
+void BufferPool::release( Buffer& buffer )
+{
+    if( !buffer.data ) return;
+    mStatistics.bytes -= buffer.bytes;
+    if( buffer.huge ) mStatistics.huge_bytes -= buffer.bytes;
+    free( buffer.data );
+    buffer = Buffer();
+}
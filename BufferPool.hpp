@@ -0,0 +1,113 @@
+#ifndef __BufferPool_hpp_
+#define __BufferPool_hpp_
+
+// C++ includes
+#include <cstddef>
+#include <vector>
+
+/// @brief The BufferPool owns a small set of persistent communication buffers (slots) that
+/// are reused across exchanges and across tags. Buffers are 64-byte aligned (cache line and
+/// AVX-512 friendly), and large buffers can optionally be backed by 2 MB transparent huge
+/// pages (madvise(MADV_HUGEPAGE) on Linux) to reduce TLB misses when packing. A buffer is
+/// only reallocated when a larger size is requested, and every allocation is counted so
+/// that the absence of allocations in steady state can be verified. New buffers are touched
+/// by the allocating thread, so that their pages are placed on its NUMA node (first touch).
+class BufferPool
+{
+  public:
+    /// @brief Allocation statistics of the pool
+    struct Statistics
+    {
+        size_t allocations{ 0 };   /// number of buffer (re)allocations since the last reset
+        size_t acquisitions{ 0 };  /// number of buffer requests since the last reset
+        size_t bytes{ 0 };         /// total capacity of all the buffers (bytes)
+        size_t huge_bytes{ 0 };    /// capacity advised to use transparent huge pages (bytes)
+    };
+
+    /// @brief Constructor
+    /// @param nslots Number of independent buffers in the pool
+    explicit BufferPool( size_t nslots = 2 );
+    ~BufferPool();
+
+    BufferPool( const BufferPool& )            = delete;
+    BufferPool& operator=( const BufferPool& ) = delete;
+
+    /// @brief Request transparent huge pages for the buffers allocated from now on
+    void set_huge_pages( bool enable )
+    {
+        mHugePages = enable;
+    }
+
+    /// @brief Make sure that a buffer can hold at least count doubles (setup: neither the request nor
+    ///        the allocation are counted)
+    void reserve( size_t slot, size_t count );
+
+    /// @brief Get a buffer of at least count doubles (the content is not preserved when it grows)
+    double* acquire( size_t slot, size_t count )
+    {
+        ++mStatistics.acquisitions;
+        Buffer& buffer = mBuffers[slot];
+        if( count > buffer.capacity )
+        {
+            grow( buffer, count );
+            ++mStatistics.allocations;
+        }
+        return buffer.data;
+    }
+
+    /// @brief Append empty slots to the pool (the existing buffers are kept)
+    void add_slots( size_t count )
+    {
+        mBuffers.resize( mBuffers.size() + count );
+    }
+
+    /// @brief Number of buffers in the pool
+    size_t num_slots() const
+    {
+        return mBuffers.size();
+    }
+
+    /// @brief Current memory of a buffer (nullptr and 0 if not allocated)
+    const void* data( size_t slot ) const
+    {
+        return mBuffers[slot].data;
+    }
+    size_t bytes( size_t slot ) const
+    {
+        return mBuffers[slot].bytes;
+    }
+
+    /// @brief Allocation statistics (capacities are current, counts are since the last reset)
+    const Statistics& statistics() const
+    {
+        return mStatistics;
+    }
+
+    /// @brief Reset the allocation and acquisition counts (the buffers are kept)
+    void reset_counts()
+    {
+        mStatistics.allocations  = 0;
+        mStatistics.acquisitions = 0;
+    }
+
+  private:
+    struct Buffer
+    {
+        double* data{ nullptr };
+        size_t capacity{ 0 };  /// number of doubles
+        size_t bytes{ 0 };     /// allocated size (rounded up to the alignment)
+        bool huge{ false };
+    };
+
+    /// @brief Replace a buffer with a larger one
+    void grow( Buffer& buffer, size_t count );
+
+    /// @brief Release the memory of a buffer
+    void release( Buffer& buffer );
+
+    std::vector< Buffer > mBuffers;
+    Statistics mStatistics;
+    bool mHugePages{ false };
+};
+
+#endif  // #ifndef __BufferPool_hpp_
@@ -31,6 +31,11 @@
  */
 // Example Includes
 #include "ExchangeHalos.hpp"
+#include "HaloExchange.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // C++ includes
 #include <iostream>
@@ -44,8 +49,16 @@ using namespace std;
 //
 int main( int argc, char** argv )
 {
-    // Initialize MPI first
-    MPI_Init( &argc, &argv );
+    // Initialize MPI first; full thread support is only requested for the threaded halo exchange,
+    // since it can make every MPI call more expensive
+    bool threadMultiple = false;
+    for( int iarg = 1; iarg < argc; ++iarg )
+    {
+        const std::string arg = argv[iarg];
+        threadMultiple |= ( arg == "--mpithreads" || arg == "--progress" );
+    }
+    int threadSupport = MPI_THREAD_SINGLE;
+    MPI_Init_thread( &argc, &argv, threadMultiple ? MPI_THREAD_MULTIPLE : MPI_THREAD_FUNNELED, &threadSupport );
 
     {
         // Create our context for this example run
@@ -54,38 +67,77 @@ int main( int argc, char** argv )
 
         // Get the input options
         context.ParseCLOptions( argc, argv );
+        if( context.thread_multiple && threadSupport < MPI_THREAD_MULTIPLE )
+        {
+            dbgprint( "Warning:: The MPI library does not provide MPI_THREAD_MULTIPLE; threaded exchanges disabled" );
+            context.thread_multiple = false;
+        }
+        int numThreads = 1;
+#ifdef _OPENMP
+        numThreads = omp_get_max_threads();
+#endif
 
         /////////////////////////////////////////////////////////////////////////
         // Print out the input parameters in use
         dbgprint( " -- Input Parameters -- " );
         dbgprint( "    Number of Processes  = " << context.num_procs );
+        dbgprint( "    Threads per Process  = " << numThreads );
         dbgprint( "    Input mesh           = " << context.input_filename );
         dbgprint( "    Ghost Layers         = " << context.ghost_layers );
         dbgprint( "    Scalar Tag name      = " << context.scalar_tagname );
         dbgprint( "    Vector Tag name      = " << context.vector_tagname );
-        dbgprint( "    Vector Tag length    = " << context.vector_length << endl );
+        dbgprint( "    Scalar field         = " << context.scalar_field );
+        dbgprint( "    Vector field         = " << context.vector_field );
+        dbgprint( "    Vector Tag length    = " << context.vector_length );
+        dbgprint( "    Vector Tag layout    = " << ( context.soa_layout ? "SoA (one tag per level)" : "AoS" ) << endl );
         /////////////////////////////////////////////////////////////////////////
 
         // Timer storage for all phases
         double elapsed_times[4];
 
+        // Measure the achievable latency, network and memory bandwidth on this communicator
+        if( context.roofline_report ) context.measure_baselines();
+
         // Read the input file specified by user, in parallel, using appropriate options
         // Supports reading partitioned h5m files and MPAS nc files directly with online Zoltan partitioning
         context.timer_push( "Read input file" );
         {
+            const double tTrace = context.tracer.now();
             // Load the file from disk with given options
             runchk( context.load_file( false ), "MOAB::load_file failed for filename: " << context.input_filename );
+            context.tracer.record_since( TraceRecorder::READ_MESH, tTrace );
         }
         context.timer_pop();
         elapsed_times[0] = context.last_elapsed();
 
+        // Renumber the local cells for memory locality, while they are not yet shared with other ranks
+        if( context.sfc_reorder )
+        {
+            context.timer_push( "Reorder cells along a Hilbert curve" );
+            runchk( context.reorder_cells(), "Reordering the cells failed" );
+            context.timer_pop();
+        }
+
         // Let the actual measurements begin...
         dbgprint( "\n- Starting execution -\n" );
 
+        // Cells created by every ghost layer ([0] = the cells of the partition), recorded for the
+        // depth-selective exchanges and the communication-avoiding time steps
+        const bool recordLayers = context.depth_exchange || context.comm_avoiding;
+        std::vector< Range > layerCells;
+        if( recordLayers )
+        {
+            layerCells.resize( 1 );
+            runchk( context.moab_interface->get_entities_by_dimension( context.fileset, context.dimension,
+                                                                        layerCells[0] ),
+                    "Getting 2D entities failed" );
+        }
+
         // We need to set up the ghost layers requested by the user. First correct for thin layers and then
         // call `exchange_ghost_cells` to prepare the mesh for use with halo regions
         context.timer_push( "Setup ghost layers" );
         {
+            const double tTrace = context.tracer.now();
             // Loop over the number of ghost layers needed and ask MOAB for layers 1 at a time
             for( int ighost = 0; ighost < context.ghost_layers; ++ighost )
             {
@@ -103,17 +155,31 @@ int main( int argc, char** argv )
                 if( ighost < context.ghost_layers - 1 )
                     runchk( context.parallel_communicator->correct_thin_ghost_layers(),
                             "Thin layer correction failed" );
+
+                if( recordLayers )
+                {
+                    Range cells;
+                    runchk( context.moab_interface->get_entities_by_dimension( context.fileset, context.dimension,
+                                                                                cells ),
+                            "Getting 2D entities failed" );
+                    for( auto& layer : layerCells )
+                        cells = subtract( cells, layer );
+                    layerCells.push_back( cells );
+                }
             }
+            context.tracer.record_since( TraceRecorder::GHOST_SETUP, tTrace );
         }
         context.timer_pop();
         elapsed_times[1] = context.last_elapsed();
 
         // Get the 2D MPAS elements and filter it so that we have only owned elements
-        Range dimEnts;
+        Range dimEnts, ghostedEnts;
         {
             // Get all entities of dimension = dim
             runchk( context.moab_interface->get_entities_by_dimension( context.fileset, context.dimension, dimEnts ),
                     "Getting 2D entities failed" );
+            // Keep the complete list (owned + ghosted) for the instrumented halo exchange
+            ghostedEnts = dimEnts;
             // Get only owned entities! The ghosted/shared entities will get their data when we exchange
             // So let us filter entities based on the status: NOT x NOT_OWNED = OWNED status :-)
             runchk( context.parallel_communicator->filter_pstatus( dimEnts, PSTATUS_NOT_OWNED, PSTATUS_NOT ),
@@ -131,11 +197,84 @@ int main( int argc, char** argv )
         }
 
         Tag tagScalar = nullptr;
-        Tag tagVector = nullptr;
+        std::vector< Tag > tagVector;
         // Create two tag handles: scalar_variable and vector_variable
         // Set these tags with appropriate closed form functional data
         // based on element centroid information
-        runchk( context.create_sv_tags( tagScalar, tagVector, dimEnts ), "Unable to create scalar and vector tags" );
+        std::vector< double > centroids;
+        context.timer_push( "Compute element centroids" );
+        {
+            runchk( context.compute_centroids( dimEnts, centroids ), "Computing element centroids failed" );
+        }
+        context.timer_pop();
+
+        const double tTrace = context.tracer.now();
+        context.timer_push( "Create tags" );
+        {
+            runchk( context.create_sv_tags( tagScalar, tagVector ), "Unable to create scalar and vector tags" );
+        }
+        context.timer_pop();
+
+        context.timer_push( "Initialize tag data" );
+        {
+            const int scalarField = FieldFunctions::type_from_name( context.scalar_field );
+            const int vectorField = FieldFunctions::type_from_name( context.vector_field );
+            if( scalarField < 0 || vectorField < 0 )
+                runchk( MB_FAILURE, "Unknown analytical field; available: " << FieldFunctions::all_names() );
+            // The levels of the vector field are scaled by (level+1), whatever the layout
+            std::vector< Tag > tags( 1, tagScalar );
+            std::vector< int > functions( 1, scalarField );
+            std::vector< double > scales( 1, 1.0 );
+            for( size_t level = 0; level < tagVector.size(); ++level )
+            {
+                tags.push_back( tagVector[level] );
+                functions.push_back( vectorField );
+                scales.push_back( tagVector.size() > 1 ? level + 1.0 : 1.0 );
+            }
+            runchk( context.initialize_tags( tags, functions, scales, dimEnts, centroids ),
+                    "Unable to initialize scalar and vector tags" );
+        }
+        context.timer_pop();
+        context.tracer.record_since( TraceRecorder::TAG_CREATION, tTrace );
+
+        // MOAB allocates and fills dense tag storage from the main thread: make sure that the tag data
+        // of the owned and ghosted cells lives on the NUMA node of the rank
+        if( context.numa_placement )
+        {
+            std::vector< NumaUtils::Region > regions;
+            std::vector< Tag > tags( 1, tagScalar );
+            tags.insert( tags.end(), tagVector.begin(), tagVector.end() );
+            context.timer_push( "Place tag data on the local NUMA node" );
+            runchk( context.tag_regions( tags, ghostedEnts, regions ), "Locating tag storage failed" );
+            context.place_numa( "tag data", regions, true );
+            context.timer_pop();
+        }
+
+        // The exchange pattern (neighbors, send and receive lists) is needed by the instrumented
+        // halo engine and to convert the measured exchange times into bandwidth and message rates
+        const bool useHaloEngine =
+            context.imbalance_report || context.perf_counters || context.tracer.enabled() || context.recv_in_place ||
+            context.pack_datatypes || context.thread_multiple || context.partition_bytes > 0 ||
+            context.chunk_bytes > 0 || context.progress_thread || context.coroutines || context.reduce_exchange ||
+            context.depth_exchange || context.comm_avoiding || context.time_steps > 0;
+        // Ghost layer of every cell, so that the engine can exchange the first layers only
+        std::vector< int > ghostLayers;
+        if( recordLayers )
+        {
+            ghostLayers.assign( ghostedEnts.size(), 0 );
+            for( size_t ilayer = 1; ilayer < layerCells.size(); ++ilayer )
+                for( auto cell : layerCells[ilayer] )
+                {
+                    const int index = ghostedEnts.index( cell );
+                    if( index >= 0 ) ghostLayers[index] = static_cast< int >( ilayer );
+                }
+        }
+        HaloExchange halo( context.moab_interface, context.parallel_communicator );
+        // The cell adjacency of the stencils is built once, in the dense tag order of the ghosted cells
+        if( context.adjacency_cache || context.stencil_sweeps > 0 || context.comm_avoiding || context.time_steps > 0 )
+            runchk( context.build_adjacency_cache( ghostedEnts ), "Building the cell adjacency cache failed" );
+        if( useHaloEngine || context.roofline_report || context.mpi_baseline )
+            runchk( halo.setup( ghostedEnts, ghostLayers ), "Setting up the halo exchange pattern failed" );
 
         // let us write out the local mesh before tag_exchange is called
         // we expect to see data only on the owned entities - and ghosted entities should have default values
@@ -151,22 +290,225 @@ int main( int argc, char** argv )
         context.timer_push( "Exchange scalar tag data" );
         for( auto irun = 0; irun < context.num_max_exchange; ++irun )
         {
+            const double tTrace = context.tracer.now();
             // Exchange scalar tags between processors
             runchk( context.parallel_communicator->exchange_tags( tagScalar, dimEnts ),
                     "Exchanging scalar tag between processors failed" );
+            context.tracer.record_since( TraceRecorder::EXCHANGE_TAGS, tTrace );
         }
         context.timer_pop( context.num_max_exchange );
         elapsed_times[2] = context.last_elapsed();
+        if( context.roofline_report ) context.report_roofline( "scalar", halo, 1, elapsed_times[2] );
+        if( context.mpi_baseline )
+        {
+            context.timer_push( "Replay scalar exchange pattern with raw MPI" );
+            runchk( halo.replay( 1, context.num_max_exchange ), "Raw MPI replay of scalar exchange failed" );
+            context.timer_pop( context.num_max_exchange );
+            dbgprint( "    Framework overhead of scalar exchange_tags = "
+                      << elapsed_times[2] - context.last_elapsed() << " ("
+                      << 100.0 * ( elapsed_times[2] - context.last_elapsed() ) / elapsed_times[2] << "%)" );
+        }
 
         context.timer_push( "Exchange vector tag data" );
         for( auto irun = 0; irun < context.num_max_exchange; ++irun )
         {
+            const double tTrace = context.tracer.now();
             // Exchange vector tags between processors
-            runchk( context.parallel_communicator->exchange_tags( tagVector, dimEnts ),
+            runchk( context.parallel_communicator->exchange_tags( tagVector, tagVector, dimEnts ),
                     "Exchanging vector tag between processors failed" );
+            context.tracer.record_since( TraceRecorder::EXCHANGE_TAGS, tTrace );
         }
         context.timer_pop( context.num_max_exchange );
         elapsed_times[3] = context.last_elapsed();
+        if( context.roofline_report )
+            context.report_roofline( "vector", halo, context.vector_length, elapsed_times[3] );
+        if( context.mpi_baseline )
+        {
+            context.timer_push( "Replay vector exchange pattern with raw MPI" );
+            runchk( halo.replay( context.vector_length, context.num_max_exchange ),
+                    "Raw MPI replay of vector exchange failed" );
+            context.timer_pop( context.num_max_exchange );
+            dbgprint( "    Framework overhead of vector exchange_tags = "
+                      << elapsed_times[3] - context.last_elapsed() << " ("
+                      << 100.0 * ( elapsed_times[3] - context.last_elapsed() ) / elapsed_times[3] << "%)" );
+        }
+
+        // Repeat the exchanges with the instrumented halo engine to analyze the load imbalance
+        // of the pack, wait and unpack phases on every rank, the hardware counters of packing
+        // and the timeline of the individual messages
+        if( useHaloEngine )
+        {
+            // The packing runs on the master thread only (threaded exchanges are not measured)
+            PerfCounters packCounters( false );
+            if( context.perf_counters ) halo.set_pack_counters( &packCounters );
+            if( context.tracer.enabled() ) halo.set_trace( &context.tracer );
+            halo.set_receive_in_place( context.recv_in_place );
+            // Size the persistent buffers once for the largest exchange (the vector field)
+            halo.set_huge_pages( context.huge_pages );
+            halo.reserve_buffers( context.vector_length );
+            if( context.numa_placement )
+            {
+                std::vector< NumaUtils::Region > regions;
+                for( size_t slot = 0; slot < halo.buffers().num_slots(); ++slot )
+                    regions.push_back( { halo.buffers().data( slot ), halo.buffers().bytes( slot ) } );
+                context.place_numa( "halo buffers", regions, true );
+            }
+
+            const std::pair< std::vector< Tag >, std::string > fields[] = { { { tagScalar }, "scalar" },
+                                                                             { tagVector, "vector" } };
+            // Explicit pack buffers are always measured; MPI derived datatypes, MPI-4 partitioned
+            // messages and pipelined chunks are compared on request. The threaded exchange is compared
+            // against the exchange driven by the master thread only
+            const char* strategyNames[] = { "", " (datatype packing)", " (partitioned)", " (pipelined)" };
+            std::vector< HaloExchange::PackStrategy > strategies( 1, HaloExchange::PACK_BUFFER );
+            if( context.pack_datatypes ) strategies.push_back( HaloExchange::PACK_DATATYPE );
+            if( context.partition_bytes > 0 )
+            {
+                if( HaloExchange::partitioned_available() )
+                {
+                    halo.set_partition_bytes( context.partition_bytes );
+                    strategies.push_back( HaloExchange::PACK_PARTITIONED );
+                }
+                else
+                    dbgprint( "Warning:: The MPI library does not support partitioned communication (MPI-4); "
+                              "partitioned exchanges skipped" );
+            }
+            if( context.chunk_bytes > 0 )
+            {
+                halo.set_chunk_bytes( context.chunk_bytes );
+                strategies.push_back( HaloExchange::PACK_PIPELINED );
+            }
+            std::vector< bool > threadModes( 1, false );
+            if( context.thread_multiple ) threadModes.push_back( true );
+            for( auto& field : fields )
+                for( auto strategy : strategies )
+                    for( bool threaded : threadModes )
+                    {
+                        // partitioned messages are always packed by all the threads (when MPI allows it), and
+                        // pipelined chunks by the master thread
+                        if( threaded && ( strategy == HaloExchange::PACK_PARTITIONED ||
+                                          strategy == HaloExchange::PACK_PIPELINED ) )
+                            continue;
+                        const std::string label = field.second + strategyNames[strategy] +
+                                                  ( threaded ? " (" + std::to_string( numThreads ) + " threads)" : "" );
+                        halo.set_pack_strategy( strategy );
+                        halo.set_threaded( threaded );
+                        halo.reset_timers();
+                        context.timer_push( "Instrumented exchange of " + label + " tag data" );
+                        for( auto irun = 0; irun < context.num_max_exchange; ++irun )
+                        {
+                            const double tTrace = context.tracer.now();
+                            runchk( halo.exchange( field.first ),
+                                    "Instrumented exchange of " << label << " tag failed" );
+                            context.tracer.record_since( TraceRecorder::HALO_EXCHANGE, tTrace );
+                        }
+                        context.timer_pop( context.num_max_exchange );
+                        if( context.perf_counters && !threaded )
+                        {
+                            context.report_counters( "Pack " + label + " tag data", packCounters,
+                                                     context.num_max_exchange );
+                            packCounters.reset();
+                        }
+                        if( context.imbalance_report ) context.report_imbalance( label, halo );
+                        context.report_buffers( label, halo );
+                        if( context.recv_in_place )
+                        {
+                            size_t inPlace = 0, total = 0;
+                            halo.received_bytes( inPlace, total );
+                            unsigned long long localBytes[2] = { inPlace, total }, globalBytes[2] = { 0, 0 };
+                            MPI_Reduce( localBytes, globalBytes, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0,
+                                        context.parallel_communicator->comm() );
+                            const double percent = globalBytes[1] ? 100.0 * globalBytes[0] / globalBytes[1] : 0.0;
+                            dbgprint( "    Ghost bytes of " << label << " tag received in place = " << percent
+                                                            << "% of " << globalBytes[1] << " bytes" );
+                        }
+                    }
+            halo.set_pack_counters( nullptr );
+            halo.set_trace( nullptr );
+
+            // Overlap of the split-phase exchanges with synthetic compute, without and with a progress thread
+            if( context.progress_thread )
+            {
+                halo.set_pack_strategy( HaloExchange::PACK_BUFFER );
+                halo.set_threaded( false );
+                for( auto& field : fields )
+                    runchk( context.report_overlap( field.second, halo, field.first, context.num_max_exchange ),
+                            "Measuring the overlap of " << field.second << " exchanges failed" );
+                // All the ranks measure with a progress thread, or none of them
+                int pinnedCpu = -1, threadSupport = MPI_THREAD_SINGLE;
+                int started   = halo.start_progress_thread( context.progress_cpu, pinnedCpu ) ? 1 : 0;
+                MPI_Allreduce( MPI_IN_PLACE, &started, 1, MPI_INT, MPI_MIN, context.parallel_communicator->comm() );
+                MPI_Query_thread( &threadSupport );
+                if( started )
+                {
+                    dbgprint( "    Progress thread of rank 0 pinned to CPU " << pinnedCpu );
+                    for( auto& field : fields )
+                        runchk( context.report_overlap( field.second + " (progress thread)", halo, field.first,
+                                                        context.num_max_exchange ),
+                                "Measuring the overlap of " << field.second << " exchanges failed" );
+                    halo.stop_progress_thread();
+                }
+                else if( threadSupport < MPI_THREAD_MULTIPLE )
+                    dbgprint( "Warning:: The MPI library does not provide MPI_THREAD_MULTIPLE; no progress thread" );
+                else
+                {
+                    halo.stop_progress_thread();
+                    dbgprint( "Warning:: A rank may only run on the CPU of the progress thread; no progress thread "
+                              "(bind the ranks to two CPUs or more, or give a spare CPU with --progress-cpu)" );
+                }
+            }
+
+            // Scalar and vector exchanges in flight at the same time as coroutines, against one after the other
+            if( context.coroutines )
+            {
+                halo.set_pack_strategy( HaloExchange::PACK_BUFFER );
+                halo.set_threaded( false );
+                runchk( context.report_concurrency( halo, fields[0].first, fields[1].first, context.num_max_exchange ),
+                        "Measuring the concurrent exchanges failed" );
+            }
+
+            // Exchanges of the first ghost layers only, for every depth
+            if( context.depth_exchange )
+            {
+                halo.set_pack_strategy( HaloExchange::PACK_BUFFER );
+                halo.set_threaded( false );
+                for( auto& field : fields )
+                    runchk( context.run_depth_exchanges( field.second, halo, field.first, context.num_max_exchange ),
+                            "Depth-selective exchanges of " << field.second << " tag failed" );
+            }
+
+            // Reverse exchange of ghost contributions onto the owners
+            if( context.reduce_exchange )
+            {
+                halo.reset_timers();
+                runchk( context.run_reductions( halo, ghostedEnts, context.num_max_exchange ),
+                        "Reduction of ghost contributions failed" );
+            }
+
+            // Stencil time steps on the owned and ghosted cells, with the default exchange settings
+            const RuntimeContext::CellAdjacency& adjacency = context.cell_adjacency;
+            halo.set_pack_strategy( HaloExchange::PACK_BUFFER );
+            halo.set_threaded( false );
+
+            // Several stencil steps between exchanges of all the ghost layers, trading redundant
+            // computation on the ghosts for fewer messages
+            if( context.comm_avoiding )
+                runchk( context.run_comm_avoiding( halo, tagScalar, ghostedEnts, ghostLayers, adjacency,
+                                                   context.num_max_exchange ),
+                        "Communication-avoiding time steps failed" );
+
+            // End-to-end time loop: one exchange and one advection-diffusion step of the scalar field
+            if( context.time_steps > 0 )
+                runchk( context.run_time_loop( halo, tagScalar, ghostedEnts, dimEnts, adjacency, context.time_steps ),
+                        "Advection-diffusion time loop failed" );
+        }
+
+        // Representative horizontal stencil on the vector field, reading the ghost values that were
+        // just exchanged, to compare the compute cost of the AoS and SoA layouts
+        if( context.stencil_sweeps > 0 )
+            runchk( context.run_stencil( "vector", tagVector, ghostedEnts, dimEnts, context.cell_adjacency,
+                                         context.stencil_sweeps ),
+                    "Stencil sweep of vector field failed" );
 
         // let us write out the local mesh after tag_exchange is called
         // we expect to see real data on both owned and ghost entities in halo regions (non-default values)
@@ -187,6 +529,14 @@ int main( int argc, char** argv )
                     "File write failed" );
         }
 
+        // Export the event timeline of all ranks
+        if( context.tracer.enabled() )
+        {
+            dbgprint( "> Writing the event timeline in Chrome trace format. File = " << context.trace_filename );
+            if( !context.tracer.write_chrome_trace( context.trace_filename, context.parallel_communicator->comm() ) )
+                dbgprint( "Error:: Writing the trace file failed" );
+        }
+
         // Consolidated timing results: the data is listed as follows
         // [ntasks,  nghosts,  load_mesh(I/O),  exchange_ghost_cells(setup), exchange_tags(scalar),
         // exchange_tags(vector)]
@@ -1,33 +1,30 @@
+// MOAB includes
+#include "moab/ReorderTool.hpp"
+
 // Example Includes
 #include "ExchangeHalos.hpp"
+#include "HaloExchange.hpp"
+#include "HaloCoroutines.hpp"
+#include "FieldFunctions.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 // C++ includes
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <numeric>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <limits>
 
-/// @brief Evaluate some closed-form Spherical Harmonic functions with an optional multiplier term
-/// @param lon Longitude in lat-lon space
-/// @param lat Latitude  in lat-lon space
-/// @param type Function type
-/// @param multiplier Optional multiplier to scale value (default=1.0)
-/// @return
-static double evaluate_function( double lon, double lat, int type = 1, double multiplier = 1.0 )
-{
-    switch( type )
-    {
-        case 1:
-            return ( 2.0 + std::pow( sin( 2.0 * lat ), 16.0 ) * cos( 16.0 * lon ) ) * multiplier;
-        default:
-            return ( 2.0 + cos( lon ) * cos( lon ) * cos( 2.0 * lat ) ) * multiplier;
-    }
-}
-
-moab::ErrorCode RuntimeContext::create_sv_tags( moab::Tag& tagScalar, moab::Tag& tagVector,
-                                                moab::Range& entities ) const
+moab::ErrorCode RuntimeContext::create_sv_tags( moab::Tag& tagScalar, std::vector< moab::Tag >& tagVector ) const
 {
-    // Get element (centroid) coordinates so that we can evaluate some arbitrary data
-    std::vector< double > entCoords = compute_centroids( entities );  // [entities * [lon, lat]]
-
     if( proc_id == 0 ) std::cout << "> Getting scalar tag handle " << scalar_tagname << "..." << std::endl;
     double defSTagValue = -1.0;
     bool createdTScalar = false;
@@ -39,44 +36,107 @@ moab::ErrorCode RuntimeContext::create_sv_tags( moab::Tag& tagScalar, moab::Tag&
 
     // we expect to create a new tag -- fail if Tag already exists since we do not want to overwrite data
     assert( createdTScalar );
-    // set the data for scalar tag with an analytical Spherical Harmonic function
+
+    tagVector.clear();
+    if( soa_layout )
     {
-        std::vector< double > tagValues( entities.size(), -1.0 );
-        std::generate( tagValues.begin(), tagValues.end(), [=, &entCoords]() {
-            static int index = 0;
-            const int offset = index++ * 2;
-            return evaluate_function( entCoords[offset], entCoords[offset + 1] );
-        } );
-        // Set local scalar tag data for exchange
-        runchk( moab_interface->tag_set_data( tagScalar, entities, tagValues.data() ),
-                "Setting scalar tag data failed" );
+        if( proc_id == 0 )
+            std::cout << "> Getting " << vector_length << " level tag handles " << vector_tagname << "_<level>..."
+                      << std::endl;
+        // Get or create one scalar tag per level: names = "vector_variable_0", "vector_variable_1", ...
+        // Type: double, Components: 1, Layout: Dense (all entities potentially), Default: -1.0
+        for( int level = 0; level < vector_length; ++level )
+        {
+            moab::Tag tagLevel  = nullptr;
+            bool createdTLevel  = false;
+            std::string tagname = vector_tagname + "_" + std::to_string( level );
+            runchk( moab_interface->tag_get_handle( tagname.c_str(), 1, moab::MB_TYPE_DOUBLE, tagLevel,
+                                                    moab::MB_TAG_CREAT | moab::MB_TAG_DENSE, &defSTagValue,
+                                                    &createdTLevel ),
+                    "Retrieving vector level tag handle failed" );
+            assert( createdTLevel );
+            tagVector.push_back( tagLevel );
+        }
+        return moab::MB_SUCCESS;
     }
 
     if( proc_id == 0 ) std::cout << "> Getting vector tag handle " << vector_tagname << "..." << std::endl;
     std::vector< double > defVTagValue( vector_length, -1.0 );
     bool createdTVector = false;
+    moab::Tag tagAll    = nullptr;
     // Get or create the scalar tag: default name = "vector_variable"
     // Type: double, Components: vector_length, Layout: Dense (all entities potentially), Default: [-1.0,..]
-    runchk( moab_interface->tag_get_handle( vector_tagname.c_str(), vector_length, moab::MB_TYPE_DOUBLE, tagVector,
+    runchk( moab_interface->tag_get_handle( vector_tagname.c_str(), vector_length, moab::MB_TYPE_DOUBLE, tagAll,
                                             moab::MB_TAG_CREAT | moab::MB_TAG_DENSE, defVTagValue.data(),
                                             &createdTVector ),
             "Retrieving vector tag handle failed" );
 
     // we expect to create a new tag -- fail if Tag already exists since we do not want to overwrite data
     assert( createdTVector );
-    // set the data for vector tag with an analytical Spherical Harmonic function
-    // with an optional scaling for each component; just to make it look different :-)
+    tagVector.push_back( tagAll );
+
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode RuntimeContext::initialize_tags( const std::vector< moab::Tag >& tags,
+                                                 const std::vector< int >& functions,
+                                                 const std::vector< double >& scales, const moab::Range& entities,
+                                                 const std::vector< double >& centroids ) const
+{
+    assert( tags.size() == functions.size() && tags.size() == scales.size() );
+    assert( centroids.size() == 2 * entities.size() );
+    const double* lon = centroids.data();
+    const double* lat = centroids.data() + entities.size();
+
+    // Entities are processed in blocks: the field is evaluated for a whole block with the
+    // vectorized batch evaluator, and then scaled by the per-component multipliers
+    const int blockSize = 256;
+    for( size_t itag = 0; itag < tags.size(); ++itag )
     {
-        const int veclength = vector_length;
-        std::vector< double > tagValues( entities.size() * veclength, -1.0 );
-        std::generate( tagValues.begin(), tagValues.end(), [=, &entCoords]() {
-            static int index = 0;
-            const int offset = ( index++ / veclength ) * 2;
-            return evaluate_function( entCoords[offset], entCoords[offset + 1], 2, ( index % veclength + 1.0 ) );
-        } );
-        // Set local tag data for exchange
-        runchk( moab_interface->tag_set_data( tagVector, entities, tagValues.data() ),
-                "Setting vector tag data failed" );
+        int ncomp = 1;
+        runchk( moab_interface->tag_get_length( tags[itag], ncomp ), "Getting tag length failed" );
+        const int type = functions[itag];
+        // scale each component differently; just to make the components look different :-)
+        std::vector< double > multipliers( ncomp );
+        for( int ic = 0; ic < ncomp; ++ic )
+            multipliers[ic] = scales[itag] * ( ncomp > 1 ? ic + 1.0 : 1.0 );
+
+        // Write directly into dense tag storage, one contiguous chunk of entities at a time
+        size_t offset = 0;
+        for( auto it = entities.begin(); it != entities.end(); )
+        {
+            int count  = 0;
+            void* data = nullptr;
+            runchk( moab_interface->tag_iterate( tags[itag], it, entities.end(), count, data ),
+                    "Iterating over dense tag storage failed" );
+            double* values   = static_cast< double* >( data );
+            const int nblocks = ( count + blockSize - 1 ) / blockSize;
+
+            // Every block of entities is independent
+#pragma omp parallel for schedule( static )
+            for( int ib = 0; ib < nblocks; ++ib )
+            {
+                const int first = ib * blockSize, nents = std::min( blockSize, count - first );
+                if( ncomp == 1 )
+                {
+                    FieldFunctions::evaluate( lon + offset + first, lat + offset + first, values + first, nents,
+                                              type );
+                    if( multipliers[0] != 1.0 )
+                        for( int ie = 0; ie < nents; ++ie )
+                            values[first + ie] *= multipliers[0];
+                    continue;
+                }
+                double cellValues[blockSize];
+                FieldFunctions::evaluate( lon + offset + first, lat + offset + first, cellValues, nents, type );
+                double* blockValues = values + static_cast< size_t >( first ) * ncomp;
+                for( int ie = 0; ie < nents; ++ie )
+                    for( int ic = 0; ic < ncomp; ++ic )
+                        blockValues[ie * ncomp + ic] = multipliers[ic] * cellValues[ie];
+            }
+
+            offset += count;
+            it += count;
+        }
     }
 
     return moab::MB_SUCCESS;
@@ -122,29 +182,1488 @@ moab::ErrorCode RuntimeContext::load_file( bool load_ghosts )
     return moab_interface->load_file( input_filename.c_str(), &fileset, read_options.c_str() );
 }
 
-std::vector< double > RuntimeContext::compute_centroids( const moab::Range& entities ) const
+moab::ErrorCode RuntimeContext::compute_centroids( const moab::Range& entities,
+                                                   std::vector< double >& centroids ) const
+{
+    const size_t nents = entities.size();
+
+    // Locate the vertex coordinates in place: each chunk is a contiguous run of vertex handles
+    struct VertexChunk
+    {
+        moab::EntityHandle first, last;
+        double *x, *y, *z;
+    };
+    std::vector< VertexChunk > chunks;
+    {
+        moab::Range vertices;
+        runchk( moab_interface->get_connectivity( entities, vertices ), "Getting element vertices failed" );
+        for( auto it = vertices.begin(); it != vertices.end(); )
+        {
+            VertexChunk chunk;
+            int count = 0;
+            runchk( moab_interface->coords_iterate( it, vertices.end(), chunk.x, chunk.y, chunk.z, count ),
+                    "Iterating over vertex coordinates failed" );
+            chunk.first = *it;
+            chunk.last  = *it + count - 1;
+            chunks.push_back( chunk );
+            it += count;
+        }
+    }
+    auto find_chunk = [&chunks]( moab::EntityHandle vertex ) -> long {
+        return std::upper_bound( chunks.begin(), chunks.end(), vertex,
+                                 []( moab::EntityHandle v, const VertexChunk& c ) { return v < c.first; } ) -
+               chunks.begin() - 1;
+    };
+
+    // Connectivity of the elements, one contiguous chunk (entity sequence) at a time
+    struct ElementChunk
+    {
+        const moab::EntityHandle* connect;
+        int nverts, count;
+        size_t offset;
+    };
+    std::vector< ElementChunk > elements;
+    for( auto it = entities.begin(); it != entities.end(); )
+    {
+        moab::EntityHandle* connect = nullptr;
+        int nverts = 0, count = 0;
+        runchk( moab_interface->connect_iterate( it, entities.end(), connect, nverts, count ),
+                "Iterating over element connectivity failed" );
+        elements.push_back( { connect, nverts, count, elements.empty() ? 0 : elements.back().offset +
+                                                                                   elements.back().count } );
+        it += count;
+    }
+
+    // Area-weighted centroid of each spherical polygon: the first moment of area of a region on the
+    // unit sphere is the boundary integral 1/2 * sum_edges( theta_e * n_e ), where theta_e is the arc
+    // angle of the great-circle edge and n_e the unit normal of its plane. Its direction is the centroid.
+    std::vector< double > xc( nents ), yc( nents ), zc( nents );
+    for( auto& chunk : elements )
+    {
+#pragma omp parallel for schedule( static )
+        for( int ie = 0; ie < chunk.count; ++ie )
+        {
+            const moab::EntityHandle* conn = chunk.connect + static_cast< size_t >( ie ) * chunk.nverts;
+            long ichunk                    = 0;
+            auto unit_vertex               = [&]( moab::EntityHandle vertex, double* v ) {
+                if( vertex < chunks[ichunk].first || vertex > chunks[ichunk].last ) ichunk = find_chunk( vertex );
+                const size_t offset = vertex - chunks[ichunk].first;
+                v[0]                = chunks[ichunk].x[offset];
+                v[1]                = chunks[ichunk].y[offset];
+                v[2]                = chunks[ichunk].z[offset];
+                const double invmag = 1.0 / std::sqrt( v[0] * v[0] + v[1] * v[1] + v[2] * v[2] );
+                v[0] *= invmag;
+                v[1] *= invmag;
+                v[2] *= invmag;
+            };
+            double moment[3] = { 0.0, 0.0, 0.0 }, average[3] = { 0.0, 0.0, 0.0 };
+            auto add_edge = [&moment]( const double* a, const double* b ) {
+                const double normal[3] = { a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2],
+                                           a[0] * b[1] - a[1] * b[0] };
+                const double sinTheta =
+                    std::sqrt( normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] );
+                if( sinTheta <= 0.0 ) return;
+                const double scale = std::atan2( sinTheta, a[0] * b[0] + a[1] * b[1] + a[2] * b[2] ) / sinTheta;
+                moment[0] += scale * normal[0];
+                moment[1] += scale * normal[1];
+                moment[2] += scale * normal[2];
+            };
+
+            double first[3], prev[3], curr[3];
+            int nunique = 0;
+            for( int iv = 0; iv < chunk.nverts; ++iv )
+            {
+                // MPAS polygons with fewer edges than the sequence are padded by repeating a vertex
+                if( iv && ( conn[iv] == conn[iv - 1] || conn[iv] == conn[0] ) ) continue;
+                unit_vertex( conn[iv], curr );
+                for( int d = 0; d < 3; ++d )
+                    average[d] += curr[d];
+                if( nunique )
+                    add_edge( prev, curr );
+                else
+                    std::copy( curr, curr + 3, first );
+                std::copy( curr, curr + 3, prev );
+                ++nunique;
+            }
+            if( nunique > 2 ) add_edge( prev, first );
+
+            // Degenerate polygons fall back to the vertex average; the orientation of the polygon
+            // (clockwise or counter-clockwise) only flips the sign of the moment
+            const double dot = moment[0] * average[0] + moment[1] * average[1] + moment[2] * average[2];
+            const double* centroid = ( nunique > 2 && dot != 0.0 ) ? moment : average;
+            const double sign      = ( centroid == moment && dot < 0.0 ) ? -1.0 : 1.0;
+            xc[chunk.offset + ie]  = sign * centroid[0];
+            yc[chunk.offset + ie]  = sign * centroid[1];
+            zc[chunk.offset + ie]  = sign * centroid[2];
+        }
+    }
+
+    // Scale by magnitude so that the centroid is on the unit sphere, and compute the spherical
+    // transformation [lon, lat] with a branch-free loop that the compiler can vectorize
+    centroids.resize( 2 * nents );
+    double* lon        = centroids.data();
+    double* lat        = centroids.data() + nents;
+    const double *xptr = xc.data(), *yptr = yc.data(), *zptr = zc.data();
+#pragma omp parallel for simd schedule( static )
+    for( size_t ie = 0; ie < nents; ++ie )
+    {
+        const double invmag = 1.0 / std::sqrt( xptr[ie] * xptr[ie] + yptr[ie] * yptr[ie] + zptr[ie] * zptr[ie] );
+        const double angle  = std::atan2( yptr[ie] * invmag, xptr[ie] * invmag );
+        lon[ie]             = angle < 0.0 ? angle + 2.0 * M_PI : angle;
+        lat[ie]             = std::asin( zptr[ie] * invmag );
+    }
+
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode RuntimeContext::build_cell_adjacency( const moab::Range& cells, CellAdjacency& adjacency,
+                                                      const bool threaded ) const
+{
+    // Every polygon edge is identified by its sorted pair of vertex handles, and the cells listing
+    // the same edge are neighbors: sorting the (edge, cell) records of all the cells groups them
+    struct EdgeRecord
+    {
+        moab::EntityHandle v0, v1;
+        int cell;
+        bool operator<( const EdgeRecord& other ) const
+        {
+            return v0 != other.v0 ? v0 < other.v0 : ( v1 != other.v1 ? v1 < other.v1 : cell < other.cell );
+        }
+    };
+
+    // Connectivity of every cell, located once in the element sequences
+    const int ncells = static_cast< int >( cells.size() );
+    std::vector< const moab::EntityHandle* > cellConnect( ncells );
+    std::vector< int > cellVerts( ncells );
+    int index = 0;
+    for( auto it = cells.begin(); it != cells.end(); )
+    {
+        moab::EntityHandle* connect = nullptr;
+        int nverts = 0, count = 0;
+        runchk( moab_interface->connect_iterate( it, cells.end(), connect, nverts, count ),
+                "Iterating over element connectivity failed" );
+        for( int ie = 0; ie < count; ++ie, ++index )
+        {
+            cellConnect[index] = connect + static_cast< size_t >( ie ) * nverts;
+            cellVerts[index]   = nverts;
+        }
+        it += count;
+    }
+
+    // MPAS polygons with fewer edges than the sequence are padded by repeating a vertex: count the
+    // distinct vertices of every cell, then write its edge records at its offset
+    auto distinct_vertices = [&]( int icell, moab::EntityHandle* verts ) {
+        const moab::EntityHandle* conn = cellConnect[icell];
+        int nverts                     = 0;
+        for( int iv = 0; iv < cellVerts[icell]; ++iv )
+            if( !iv || ( conn[iv] != conn[iv - 1] && conn[iv] != conn[0] ) ) verts[nverts++] = conn[iv];
+        return nverts;
+    };
+    const int maxVerts = ncells ? *std::max_element( cellVerts.begin(), cellVerts.end() ) : 0;
+    std::vector< size_t > edgeOffsets( ncells + 1, 0 );
+#pragma omp parallel if( threaded )
+    {
+        std::vector< moab::EntityHandle > verts( maxVerts );
+#pragma omp for schedule( static )
+        for( int icell = 0; icell < ncells; ++icell )
+        {
+            const int nverts       = distinct_vertices( icell, verts.data() );
+            edgeOffsets[icell + 1] = nverts > 2 ? nverts : std::max( nverts - 1, 0 );
+        }
+    }
+    std::partial_sum( edgeOffsets.begin(), edgeOffsets.end(), edgeOffsets.begin() );
+    std::vector< EdgeRecord > edges( edgeOffsets[ncells] );
+#pragma omp parallel if( threaded )
+    {
+        std::vector< moab::EntityHandle > verts( maxVerts );
+#pragma omp for schedule( static )
+        for( int icell = 0; icell < ncells; ++icell )
+        {
+            const int nverts = distinct_vertices( icell, verts.data() );
+            for( size_t ie = edgeOffsets[icell]; ie < edgeOffsets[icell + 1]; ++ie )
+            {
+                const int iv               = static_cast< int >( ie - edgeOffsets[icell] );
+                const moab::EntityHandle a = verts[iv], b = verts[( iv + 1 ) % nverts];
+                edges[ie]                  = { std::min( a, b ), std::max( a, b ), icell };
+            }
+        }
+    }
+
+    // Threads sort contiguous segments of the records, which are then merged pairwise
+    int nsegments = 1;
+#ifdef _OPENMP
+    if( threaded ) nsegments = omp_get_max_threads();
+#endif
+    std::vector< size_t > bounds( nsegments + 1 );
+    for( int is = 0; is <= nsegments; ++is )
+        bounds[is] = edges.size() * is / nsegments;
+#pragma omp parallel for schedule( static ) if( threaded )
+    for( int is = 0; is < nsegments; ++is )
+        std::sort( edges.begin() + bounds[is], edges.begin() + bounds[is + 1] );
+    for( int width = 1; width < nsegments; width *= 2 )
+    {
+#pragma omp parallel for schedule( dynamic ) if( threaded )
+        for( int is = 0; is < nsegments - width; is += 2 * width )
+            std::inplace_merge( edges.begin() + bounds[is], edges.begin() + bounds[is + width],
+                                edges.begin() + bounds[std::min( is + 2 * width, nsegments )] );
+    }
+
+    // Cells listing the same edge are neighbors (in both directions): count them, then fill the rows
+    std::vector< std::pair< size_t, size_t > > groups;
+    for( size_t first = 0, last = 0; first < edges.size(); first = last )
+    {
+        last = first + 1;
+        while( last < edges.size() && edges[last].v0 == edges[first].v0 && edges[last].v1 == edges[first].v1 )
+            ++last;
+        if( last - first > 1 ) groups.push_back( std::make_pair( first, last ) );
+    }
+    adjacency.offsets.assign( ncells + 1, 0 );
+    for( auto& group : groups )
+        for( size_t i = group.first; i < group.second; ++i )
+            for( size_t j = group.first; j < group.second; ++j )
+                if( edges[i].cell != edges[j].cell ) ++adjacency.offsets[edges[i].cell + 1];
+    std::partial_sum( adjacency.offsets.begin(), adjacency.offsets.end(), adjacency.offsets.begin() );
+    adjacency.neighbors.resize( adjacency.offsets[ncells] );
+    std::vector< int > cursor( adjacency.offsets.begin(), adjacency.offsets.end() - 1 );
+    for( auto& group : groups )
+        for( size_t i = group.first; i < group.second; ++i )
+            for( size_t j = group.first; j < group.second; ++j )
+                if( edges[i].cell != edges[j].cell ) adjacency.neighbors[cursor[edges[i].cell]++] = edges[j].cell;
+
+    // Sorted rows, without the duplicates of cells sharing several edges
+    std::vector< int > degree( ncells );
+#pragma omp parallel for schedule( static ) if( threaded )
+    for( int icell = 0; icell < ncells; ++icell )
+    {
+        auto first = adjacency.neighbors.begin() + adjacency.offsets[icell];
+        auto last  = adjacency.neighbors.begin() + adjacency.offsets[icell + 1];
+        std::sort( first, last );
+        degree[icell] = static_cast< int >( std::unique( first, last ) - first );
+    }
+    int size = 0;
+    for( int icell = 0; icell < ncells; ++icell )
+    {
+        const int start = adjacency.offsets[icell];
+        std::copy( adjacency.neighbors.begin() + start, adjacency.neighbors.begin() + start + degree[icell],
+                   adjacency.neighbors.begin() + size );
+        adjacency.offsets[icell] = size;
+        size += degree[icell];
+    }
+    adjacency.offsets[ncells] = size;
+    adjacency.neighbors.resize( size );
+    adjacency.neighbors.shrink_to_fit();
+
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode RuntimeContext::build_adjacency_cache( const moab::Range& cells )
+{
+    timer_push( std::string( "Build cell adjacency cache" ) + ( threaded_graph ? " (threaded)" : "" ) );
+    runchk( build_cell_adjacency( cells, cell_adjacency, threaded_graph ), "Building the cell adjacency failed" );
+    timer_pop();
+
+    // Memory of the CSR arrays: [cells, neighbors, bytes], summed over the ranks, and bytes per rank (max)
+    const unsigned long long bytes =
+        ( cell_adjacency.offsets.capacity() + cell_adjacency.neighbors.capacity() ) * sizeof( int );
+    unsigned long long local[3] = { cells.size(), cell_adjacency.neighbors.size(), bytes }, global[3] = { 0, 0, 0 };
+    unsigned long long maxBytes = 0;
+    MPI_Reduce( local, global, 3, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, parallel_communicator->comm() );
+    MPI_Reduce( &bytes, &maxBytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, parallel_communicator->comm() );
+    if( proc_id == 0 )
+        std::cout << "    Cell adjacency of the owned and ghosted cells: " << global[0] << " cells, " << global[1]
+                  << " neighbors (" << ( global[0] ? static_cast< double >( global[1] ) / global[0] : 0.0 )
+                  << " per cell), memory = " << global[2] / 1024.0 / 1024.0 << " MB in total, max per rank = "
+                  << maxBytes / 1024.0 << " KB" << std::endl;
+
+    return moab::MB_SUCCESS;
+}
+
+/// @brief Distance along a Hilbert curve of order 2^bits x 2^bits of the cell (x, y)
+static uint64_t hilbert_index( const int bits, uint32_t x, uint32_t y )
+{
+    uint64_t index = 0;
+    for( uint32_t side = 1u << ( bits - 1 ); side > 0; side >>= 1 )
+    {
+        const uint32_t rx = ( x & side ) ? 1 : 0;
+        const uint32_t ry = ( y & side ) ? 1 : 0;
+        index += static_cast< uint64_t >( side ) * side * ( ( 3 * rx ) ^ ry );
+        // rotate the quadrant so that the curve is continuous
+        if( ry == 0 )
+        {
+            if( rx == 1 )
+            {
+                x = side - 1 - ( x & ( side - 1 ) );
+                y = side - 1 - ( y & ( side - 1 ) );
+            }
+            std::swap( x, y );
+        }
+    }
+    return index;
+}
+
+/// @brief Average distance between the indices of adjacent cells (a measure of memory locality)
+static double mean_neighbor_distance( const RuntimeContext::CellAdjacency& adjacency )
+{
+    double distance = 0.0;
+    for( size_t icell = 0; icell + 1 < adjacency.offsets.size(); ++icell )
+        for( int in = adjacency.offsets[icell]; in < adjacency.offsets[icell + 1]; ++in )
+            distance += std::abs( adjacency.neighbors[in] - static_cast< int >( icell ) );
+    return adjacency.neighbors.empty() ? 0.0 : distance / adjacency.neighbors.size();
+}
+
+moab::ErrorCode RuntimeContext::reorder_cells()
+{
+    // Only the local cells are renumbered: before the ghost exchange, the cells are not shared
+    // with any other rank, so that no remote handle refers to them yet
+    moab::Range cells;
+    runchk( moab_interface->get_entities_by_dimension( fileset, dimension, cells ), "Getting cells failed" );
+    CellAdjacency adjacency;
+    runchk( build_cell_adjacency( cells, adjacency, threaded_graph ), "Building the cell adjacency failed" );
+    const double distanceBefore = mean_neighbor_distance( adjacency );
+
+    // Hilbert index of the centroids in an equal-area (lon, sin(lat)) projection
+    std::vector< double > centroids;
+    runchk( compute_centroids( cells, centroids ), "Computing cell centroids failed" );
+    const size_t ncells = cells.size();
+    const int bits      = 16;
+    const double scale  = static_cast< double >( ( 1u << bits ) - 1 );
+    std::vector< uint64_t > keys( ncells );
+#pragma omp parallel for schedule( static )
+    for( size_t ic = 0; ic < ncells; ++ic )
+    {
+        const double x = centroids[ic] / ( 2.0 * M_PI ), y = 0.5 * ( std::sin( centroids[ncells + ic] ) + 1.0 );
+        keys[ic]       = hilbert_index( bits, static_cast< uint32_t >( scale * std::min( std::max( x, 0.0 ), 1.0 ) ),
+                                        static_cast< uint32_t >( scale * std::min( std::max( y, 0.0 ), 1.0 ) ) );
+    }
+
+    // Position of every cell along the curve, used as the sorting key of the new handle order
+    std::vector< int > order( ncells ), position( ncells );
+    std::iota( order.begin(), order.end(), 0 );
+    std::stable_sort( order.begin(), order.end(), [&keys]( int a, int b ) { return keys[a] < keys[b]; } );
+    for( size_t ic = 0; ic < ncells; ++ic )
+        position[order[ic]] = static_cast< int >( ic );
+
+    moab::Tag sortTag = nullptr, newHandles = nullptr;
+    const int skipValue = -1;
+    runchk( moab_interface->tag_get_handle( "__HILBERT_POSITION", 1, moab::MB_TYPE_INTEGER, sortTag,
+                                            moab::MB_TAG_DENSE | moab::MB_TAG_EXCL, &skipValue ),
+            "Creating the sorting tag failed" );
+    runchk( moab_interface->tag_set_data( sortTag, cells, position.data() ), "Setting the sorting tag failed" );
+    moab::ReorderTool reorder( dynamic_cast< moab::Core* >( moab_interface ) );
+    runchk( reorder.handle_order_from_int_tag( sortTag, skipValue, newHandles ),
+            "Computing the new handle order failed" );
+    runchk( reorder.reorder_entities( newHandles ), "Reordering the cells failed" );
+    runchk( moab_interface->tag_delete( newHandles ), "Deleting the new handle tag failed" );
+    runchk( moab_interface->tag_delete( sortTag ), "Deleting the sorting tag failed" );
+
+    // Report the improvement of the locality of the neighbor accesses
+    cells.clear();
+    runchk( moab_interface->get_entities_by_dimension( fileset, dimension, cells ), "Getting cells failed" );
+    runchk( build_cell_adjacency( cells, adjacency, threaded_graph ), "Building the cell adjacency failed" );
+    double localDistance[2] = { distanceBefore, mean_neighbor_distance( adjacency ) }, maxDistance[2], avgDistance[2];
+    MPI_Reduce( localDistance, maxDistance, 2, MPI_DOUBLE, MPI_MAX, 0, parallel_communicator->comm() );
+    MPI_Reduce( localDistance, avgDistance, 2, MPI_DOUBLE, MPI_SUM, 0, parallel_communicator->comm() );
+    if( proc_id == 0 )
+        std::cout << "    Mean index distance between adjacent cells: before = " << avgDistance[0] / num_procs
+                  << " (max " << maxDistance[0] << "), after = " << avgDistance[1] / num_procs << " (max "
+                  << maxDistance[1] << ")" << std::endl;
+
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode RuntimeContext::run_stencil( const std::string& label, const std::vector< moab::Tag >& tags,
+                                             const moab::Range& cells, const moab::Range& targets,
+                                             const CellAdjacency& adjacency, const int nsweeps )
+{
+    // Locate every cell in dense tag storage once: all the tags are defined on the same cells, so
+    // they share the chunk decomposition, and only the base address of each chunk differs per tag
+    std::vector< int > cellChunk( cells.size() ), cellOffset( cells.size() );
+    std::vector< std::vector< double* > > chunkBase( tags.size() );
+    std::vector< int > ncomps( tags.size() );
+    for( size_t itag = 0; itag < tags.size(); ++itag )
+    {
+        runchk( moab_interface->tag_get_length( tags[itag], ncomps[itag] ), "Getting tag length failed" );
+        size_t index = 0;
+        for( auto it = cells.begin(); it != cells.end(); )
+        {
+            int count  = 0;
+            void* data = nullptr;
+            runchk( moab_interface->tag_iterate( tags[itag], it, cells.end(), count, data ),
+                    "Iterating over dense tag storage failed" );
+            if( itag == 0 )
+            {
+                for( int ie = 0; ie < count; ++ie, ++index )
+                {
+                    cellChunk[index]  = static_cast< int >( chunkBase[itag].size() );
+                    cellOffset[index] = ie;
+                }
+            }
+            chunkBase[itag].push_back( static_cast< double* >( data ) );
+            it += count;
+        }
+        if( chunkBase[itag].size() != chunkBase[0].size() )
+            runchk( moab::MB_FAILURE, "Tags of the " << label << " field have different storage layouts" );
+    }
+
+    std::vector< int > targetIds;
+    targetIds.reserve( targets.size() );
+    for( auto it = targets.begin(); it != targets.end(); ++it )
+        targetIds.push_back( cells.index( *it ) );
+    const int ntargets   = static_cast< int >( targetIds.size() );
+    const int ncompTotal = std::accumulate( ncomps.begin(), ncomps.end(), 0 );
+    std::vector< double > result( static_cast< size_t >( ntargets ) * ncompTotal, 0.0 );
+
+    // The result of each tag is a contiguous section of the buffer: level-major for single-component
+    // tags (SoA) and entity-major for a multi-component tag (AoS)
+    const double nu = 0.1;
+    timer_push( "Stencil sweep of " + label + " field" );
+    for( int isweep = 0; isweep < nsweeps; ++isweep )
+    {
+        double* section = result.data();
+        for( size_t itag = 0; itag < tags.size(); ++itag )
+        {
+            const int ncomp      = ncomps[itag];
+            double* const* base  = chunkBase[itag].data();
+            const int* offsets   = adjacency.offsets.data();
+            const int* neighbors = adjacency.neighbors.data();
+#pragma omp parallel for schedule( static )
+            for( int it = 0; it < ntargets; ++it )
+            {
+                const int icell       = targetIds[it];
+                const double* ui      = base[cellChunk[icell]] + static_cast< size_t >( cellOffset[icell] ) * ncomp;
+                double* out           = section + static_cast< size_t >( it ) * ncomp;
+                const double diagonal = 1.0 - nu * ( offsets[icell + 1] - offsets[icell] );
+                for( int ic = 0; ic < ncomp; ++ic )
+                    out[ic] = diagonal * ui[ic];
+                for( int in = offsets[icell]; in < offsets[icell + 1]; ++in )
+                {
+                    const int jcell  = neighbors[in];
+                    const double* uj = base[cellChunk[jcell]] + static_cast< size_t >( cellOffset[jcell] ) * ncomp;
+                    for( int ic = 0; ic < ncomp; ++ic )
+                        out[ic] += nu * uj[ic];
+                }
+            }
+            section += static_cast< size_t >( ntargets ) * ncomp;
+        }
+    }
+    timer_pop( nsweeps );
+
+    // The checksum does not depend on the layout, so that AoS and SoA runs can be compared
+    double localSum = std::accumulate( result.begin(), result.end(), 0.0 ), globalSum = 0.0;
+    MPI_Reduce( &localSum, &globalSum, 1, MPI_DOUBLE, MPI_SUM, 0, parallel_communicator->comm() );
+    if( proc_id == 0 )
+        std::cout << "    Stencil checksum of " << label << " field = " << std::setprecision( 15 ) << globalSum
+                  << std::setprecision( 6 ) << std::endl;
+
+    return moab::MB_SUCCESS;
+}
+
+void RuntimeContext::report_imbalance( const std::string& label, const HaloExchange& halo ) const
+{
+    // Per-rank statistics: [pack, wait, unpack, total, neighbors, sent entities, received entities]
+    enum
+    {
+        PACK = 0,
+        WAIT,
+        UNPACK,
+        TOTAL,
+        NEIGHBORS,
+        SENT,
+        RECEIVED,
+        NSTATS
+    };
+    const auto& calls = halo.call_times();
+    const int nruns   = std::max( 1, static_cast< int >( calls.size() ) );
+    const auto& times = halo.phase_times();
+
+    double localStats[NSTATS] = { times.pack / nruns,
+                                  times.wait / nruns,
+                                  times.unpack / nruns,
+                                  times.total() / nruns,
+                                  static_cast< double >( halo.neighbors().size() ),
+                                  static_cast< double >( halo.num_send_entities() ),
+                                  static_cast< double >( halo.num_recv_entities() ) };
+    std::vector< double > allStats( proc_id == 0 ? num_procs * NSTATS : 0 );
+    MPI_Gather( localStats, NSTATS, MPI_DOUBLE, allStats.data(), NSTATS, MPI_DOUBLE, 0,
+                parallel_communicator->comm() );
+
+    // Find the slowest rank in every exchange call to check whether it is always the same one
+    struct
+    {
+        double value;
+        int rank;
+    } locCall = { 0.0, proc_id };
+    std::vector< decltype( locCall ) > localCalls( calls.size(), locCall ), slowestCalls( calls.size() );
+    for( size_t ic = 0; ic < calls.size(); ++ic )
+        localCalls[ic].value = calls[ic];
+    MPI_Reduce( localCalls.data(), slowestCalls.data(), static_cast< int >( calls.size() ), MPI_DOUBLE_INT,
+                MPI_MAXLOC, 0, parallel_communicator->comm() );
+
+    if( proc_id != 0 ) return;
+
+    auto stat = [&]( int rank, int index ) { return allStats[rank * NSTATS + index]; };
+
+    std::cout << "\n[IMBALANCE] " << label << " exchange over " << nruns << " runs (times per exchange)\n";
+    std::cout << "    phase      min          avg          max          max/avg\n";
+    const char* phaseNames[] = { "pack  ", "wait  ", "unpack", "total " };
+    double phaseSums[4]      = { 0.0, 0.0, 0.0, 0.0 };
+    for( int iphase = PACK; iphase <= TOTAL; ++iphase )
+    {
+        double minTime = stat( 0, iphase ), maxTime = stat( 0, iphase );
+        for( int rank = 0; rank < num_procs; ++rank )
+        {
+            minTime = std::min( minTime, stat( rank, iphase ) );
+            maxTime = std::max( maxTime, stat( rank, iphase ) );
+            phaseSums[iphase] += stat( rank, iphase );
+        }
+        const double avgTime = phaseSums[iphase] / num_procs;
+        std::cout << "    " << phaseNames[iphase] << std::scientific << std::setprecision( 4 ) << "   " << minTime
+                  << "   " << avgTime << "   " << maxTime << std::fixed << std::setprecision( 2 ) << "   "
+                  << ( avgTime > 0.0 ? maxTime / avgTime : 1.0 ) << "\n";
+    }
+    std::cout << "    wait-time fraction (all ranks) = " << std::setprecision( 1 )
+              << ( phaseSums[TOTAL] > 0.0 ? 100.0 * phaseSums[WAIT] / phaseSums[TOTAL] : 0.0 ) << "%\n";
+
+    // List the slowest ranks along with their communication pattern
+    std::vector< int > ranks( num_procs );
+    std::iota( ranks.begin(), ranks.end(), 0 );
+    const int nslowest = std::min( 5, num_procs );
+    std::partial_sort( ranks.begin(), ranks.begin() + nslowest, ranks.end(),
+                       [&]( int a, int b ) { return stat( a, TOTAL ) > stat( b, TOTAL ); } );
+    std::cout << "    slowest ranks: [rank, time, wait %, neighbors, sent, received]\n";
+    for( int is = 0; is < nslowest; ++is )
+    {
+        const int rank = ranks[is];
+        std::cout << "      [" << rank << ", " << std::scientific << std::setprecision( 4 ) << stat( rank, TOTAL )
+                  << ", " << std::fixed << std::setprecision( 1 )
+                  << ( stat( rank, TOTAL ) > 0.0 ? 100.0 * stat( rank, WAIT ) / stat( rank, TOTAL ) : 0.0 ) << ", "
+                  << stat( rank, NEIGHBORS ) << ", " << stat( rank, SENT ) << ", " << stat( rank, RECEIVED )
+                  << "]\n";
+    }
+
+    // Correlation of the local work (pack + unpack) and the total time with the boundary size
+    auto correlation = [&]( std::function< double( int ) > fx, std::function< double( int ) > fy ) {
+        double mx = 0.0, my = 0.0;
+        for( int rank = 0; rank < num_procs; ++rank )
+        {
+            mx += fx( rank );
+            my += fy( rank );
+        }
+        mx /= num_procs;
+        my /= num_procs;
+        double sxy = 0.0, sxx = 0.0, syy = 0.0;
+        for( int rank = 0; rank < num_procs; ++rank )
+        {
+            sxy += ( fx( rank ) - mx ) * ( fy( rank ) - my );
+            sxx += ( fx( rank ) - mx ) * ( fx( rank ) - mx );
+            syy += ( fy( rank ) - my ) * ( fy( rank ) - my );
+        }
+        return ( sxx > 0.0 && syy > 0.0 ) ? sxy / std::sqrt( sxx * syy ) : 0.0;
+    };
+    auto boundary = [&]( int rank ) { return stat( rank, SENT ) + stat( rank, RECEIVED ); };
+    const double workCorr =
+        correlation( boundary, [&]( int rank ) { return stat( rank, PACK ) + stat( rank, UNPACK ); } );
+    const double totalCorr = correlation( boundary, [&]( int rank ) { return stat( rank, TOTAL ); } );
+    std::cout << "    correlation with boundary size: pack+unpack = " << std::setprecision( 2 ) << workCorr
+              << ", total = " << totalCorr << "\n";
+
+    // Persistence of the slowest rank across the exchange calls
+    std::map< int, int > slowestCount;
+    for( auto& call : slowestCalls )
+        slowestCount[call.rank]++;
+    auto mostFrequent = std::max_element( slowestCount.begin(), slowestCount.end(),
+                                          []( const std::pair< const int, int >& a,
+                                              const std::pair< const int, int >& b ) { return a.second < b.second; } );
+    const double persistence =
+        slowestCalls.empty() ? 0.0 : static_cast< double >( mostFrequent->second ) / slowestCalls.size();
+    if( !slowestCalls.empty() )
+        std::cout << "    slowest rank per exchange: " << slowestCount.size() << " distinct ranks, rank "
+                  << mostFrequent->first << " slowest in " << std::setprecision( 1 ) << 100.0 * persistence
+                  << "% of the runs\n";
+
+    // A persistent slowest rank whose time follows the boundary size points to the partition,
+    // while a slowest rank that changes between calls points to network or system noise
+    const bool correlated = ( totalCorr >= 0.5 || workCorr >= 0.5 );
+    const bool persistent = ( persistence >= 0.5 );
+    std::cout << "    => likely cause: "
+              << ( correlated && persistent    ? "partition imbalance"
+                   : !correlated && !persistent ? "network/system noise"
+                                                : "mixed (partition imbalance and noise)" )
+              << std::defaultfloat << std::setprecision( 6 ) << std::endl;
+}
+
+void RuntimeContext::report_counters( const std::string& operation, const PerfCounters& counters,
+                                      const int nruns ) const
+{
+    // Events that could not be opened on some rank are reported as unavailable
+    double localCounts[PerfCounters::NUM_EVENTS], maxCounts[PerfCounters::NUM_EVENTS],
+        sumCounts[PerfCounters::NUM_EVENTS];
+    int localAvailable[PerfCounters::NUM_EVENTS], allAvailable[PerfCounters::NUM_EVENTS];
+    for( int ie = 0; ie < PerfCounters::NUM_EVENTS; ++ie )
+    {
+        const PerfCounters::Event event = static_cast< PerfCounters::Event >( ie );
+        localCounts[ie]                 = counters.count( event ) / nruns;
+        localAvailable[ie]              = counters.available( event ) ? 1 : 0;
+    }
+    MPI_Reduce( localCounts, maxCounts, PerfCounters::NUM_EVENTS, MPI_DOUBLE, MPI_MAX, 0,
+                parallel_communicator->comm() );
+    MPI_Reduce( localCounts, sumCounts, PerfCounters::NUM_EVENTS, MPI_DOUBLE, MPI_SUM, 0,
+                parallel_communicator->comm() );
+    MPI_Reduce( localAvailable, allAvailable, PerfCounters::NUM_EVENTS, MPI_INT, MPI_MIN, 0,
+                parallel_communicator->comm() );
+    if( proc_id != 0 ) return;
+
+    std::cout << "[PERF] Counters for " << operation << ( nruns > 1 ? " (per run)" : "" ) << ", "
+              << counters.num_threads() << " thread(s) :";
+    for( int ie = 0; ie < PerfCounters::NUM_EVENTS; ++ie )
+    {
+        std::cout << " " << PerfCounters::name( static_cast< PerfCounters::Event >( ie ) );
+        if( allAvailable[ie] )
+            std::cout << " max = " << maxCounts[ie] << ", avg = " << sumCounts[ie] / num_procs << ";";
+        else
+            std::cout << " n/a;";
+    }
+    // derived metrics from the aggregate counts: a low IPC with a high LLC MPKI indicates memory-bound code
+    const double instructions = sumCounts[PerfCounters::INSTRUCTIONS];
+    if( allAvailable[PerfCounters::CYCLES] && allAvailable[PerfCounters::INSTRUCTIONS] &&
+        sumCounts[PerfCounters::CYCLES] > 0.0 )
+        std::cout << " IPC = " << instructions / sumCounts[PerfCounters::CYCLES] << ";";
+    if( allAvailable[PerfCounters::INSTRUCTIONS] && instructions > 0.0 )
+    {
+        if( allAvailable[PerfCounters::LLC_MISSES] )
+            std::cout << " LLC MPKI = " << 1000.0 * sumCounts[PerfCounters::LLC_MISSES] / instructions << ";";
+        if( allAvailable[PerfCounters::DTLB_MISSES] )
+            std::cout << " dTLB MPKI = " << 1000.0 * sumCounts[PerfCounters::DTLB_MISSES] / instructions << ";";
+    }
+    std::cout << "\n";
+}
+
+void RuntimeContext::report_buffers( const std::string& label, const HaloExchange& halo ) const
+{
+    // [allocations, acquisitions, bytes, huge page bytes]: max and sum over all ranks
+    const BufferPool::Statistics& stats = halo.buffers().statistics();
+    unsigned long long local[4] = { stats.allocations, stats.acquisitions, stats.bytes, stats.huge_bytes };
+    unsigned long long maxValues[4], sumValues[4];
+    MPI_Reduce( local, maxValues, 4, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, parallel_communicator->comm() );
+    MPI_Reduce( local, sumValues, 4, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, parallel_communicator->comm() );
+    if( proc_id != 0 ) return;
+
+    std::cout << "    Halo buffers of " << label << " exchanges: " << sumValues[0] << " allocations in "
+              << sumValues[1] << " requests (max " << maxValues[0] << " per rank), capacity = "
+              << maxValues[2] / 1048576.0 << " MB per rank (max), huge pages = "
+              << ( sumValues[2] ? 100.0 * sumValues[3] / sumValues[2] : 0.0 ) << "%" << std::endl;
+}
+
+/// @brief Synthetic compute: a fixed amount of floating-point work without any MPI call, so that
+///        cycles taken by another thread on the same CPU show up in its duration
+static double synthetic_compute( const long long iterations )
+{
+    double value = 1.0;
+    for( long long i = 0; i < iterations; ++i )
+        value = value * 0.999999 + 1.0e-6;
+    return value;
+}
+
+/// @brief Number of synthetic compute iterations that take the given time on the calling thread
+static long long calibrate_compute( const double seconds )
+{
+    volatile double result = 0.0;
+    for( long long iterations = 1 << 16;; iterations *= 2 )
+    {
+        const auto start     = std::chrono::steady_clock::now();
+        result               = result + synthetic_compute( iterations );
+        const double elapsed = std::chrono::duration< double >( std::chrono::steady_clock::now() - start ).count();
+        if( elapsed >= 0.01 ) return std::max( 1LL, std::llround( iterations * seconds / elapsed ) );
+    }
+}
+
+moab::ErrorCode RuntimeContext::report_overlap( const std::string& label, HaloExchange& halo,
+                                                const std::vector< moab::Tag >& tags, const int nruns )
+{
+    MPI_Comm comm          = parallel_communicator->comm();
+    volatile double result = 0.0;
+
+    // The compute is calibrated to take as long as the exchange alone on the slowest rank, so that the
+    // exchange could be completely hidden
+    double exchangeTime = 0.0;
+    MPI_Barrier( comm );
+    double tStart = MPI_Wtime();
+    for( int irun = 0; irun < nruns; ++irun )
+    {
+        runchk( halo.begin_exchange( tags ), "Starting the split-phase exchange failed" );
+        runchk( halo.end_exchange(), "Completing the split-phase exchange failed" );
+    }
+    exchangeTime = ( MPI_Wtime() - tStart ) / nruns;
+    MPI_Allreduce( MPI_IN_PLACE, &exchangeTime, 1, MPI_DOUBLE, MPI_MAX, comm );
+    const long long iterations = calibrate_compute( exchangeTime );
+
+    // [compute alone, exchange around the compute]
+    double local[2], slowest[2];
+    MPI_Barrier( comm );
+    tStart = MPI_Wtime();
+    for( int irun = 0; irun < nruns; ++irun )
+        result = result + synthetic_compute( iterations );
+    local[0] = ( MPI_Wtime() - tStart ) / nruns;
+
+    MPI_Barrier( comm );
+    tStart = MPI_Wtime();
+    for( int irun = 0; irun < nruns; ++irun )
+    {
+        runchk( halo.begin_exchange( tags ), "Starting the split-phase exchange failed" );
+        result = result + synthetic_compute( iterations );
+        runchk( halo.end_exchange(), "Completing the split-phase exchange failed" );
+    }
+    local[1] = ( MPI_Wtime() - tStart ) / nruns;
+    MPI_Reduce( local, slowest, 2, MPI_DOUBLE, MPI_MAX, 0, comm );
+    if( proc_id != 0 ) return moab::MB_SUCCESS;
+
+    // Fraction of the exchange time saved by running it during the compute
+    const double overlap =
+        exchangeTime > 0.0 ? std::min( std::max( ( exchangeTime + slowest[0] - slowest[1] ) / exchangeTime, 0.0 ), 1.0 )
+                           : 0.0;
+    std::cout << "    Overlap of " << label << " exchange: exchange = " << exchangeTime
+              << " s, compute = " << slowest[0] << " s, exchange + compute = " << slowest[1]
+              << " s, overlap = " << 100.0 * overlap << "%" << std::endl;
+    return moab::MB_SUCCESS;
+}
+
+#ifdef HALO_HAVE_COROUTINES
+/// @brief Task exchanging a list of tags nruns times, each exchange after the previous one completed
+static ExchangeTask exchange_loop( ExchangeScheduler& scheduler, std::vector< moab::Tag > tags, const int nruns )
+{
+    for( int irun = 0; irun < nruns; ++irun )
+    {
+        moab::ErrorCode rval = co_await scheduler.exchange( tags );
+        if( rval != moab::MB_SUCCESS ) co_return rval;
+    }
+    co_return moab::MB_SUCCESS;
+}
+#endif
+
+moab::ErrorCode RuntimeContext::report_concurrency( HaloExchange& halo, const std::vector< moab::Tag >& scalarTags,
+                                                    const std::vector< moab::Tag >& vectorTags, const int nruns )
+{
+#ifdef HALO_HAVE_COROUTINES
+    MPI_Comm comm = parallel_communicator->comm();
+    ExchangeScheduler scheduler( halo );
+
+    // Open the channels of the scheduler and size their buffers before timing
+    scheduler.spawn( exchange_loop( scheduler, scalarTags, 1 ) );
+    scheduler.spawn( exchange_loop( scheduler, vectorTags, 1 ) );
+    runchk( scheduler.run(), "Concurrent exchanges failed" );
+
+    // [sequential, concurrent]
+    double local[2], slowest[2];
+    MPI_Barrier( comm );
+    double tStart = MPI_Wtime();
+    for( int irun = 0; irun < nruns; ++irun )
+    {
+        runchk( halo.exchange( scalarTags ), "Exchanging scalar tag failed" );
+        runchk( halo.exchange( vectorTags ), "Exchanging vector tag failed" );
+    }
+    local[0] = ( MPI_Wtime() - tStart ) / nruns;
+
+    MPI_Barrier( comm );
+    tStart = MPI_Wtime();
+    scheduler.spawn( exchange_loop( scheduler, scalarTags, nruns ) );
+    scheduler.spawn( exchange_loop( scheduler, vectorTags, nruns ) );
+    runchk( scheduler.run(), "Concurrent exchanges failed" );
+    local[1] = ( MPI_Wtime() - tStart ) / nruns;
+    MPI_Reduce( local, slowest, 2, MPI_DOUBLE, MPI_MAX, 0, comm );
+    if( proc_id != 0 ) return moab::MB_SUCCESS;
+
+    std::cout << "    Scalar + vector exchanges: sequential = " << slowest[0] << " s, concurrent coroutines = "
+              << slowest[1] << " s, speedup = " << ( slowest[1] > 0.0 ? slowest[0] / slowest[1] : 0.0 ) << std::endl;
+#else
+    (void)halo;
+    (void)scalarTags;
+    (void)vectorTags;
+    (void)nruns;
+    runchk( moab::MB_NOT_IMPLEMENTED, "Built without C++20 coroutine support (see CXX20FLAGS in the makefile)" );
+#endif
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode RuntimeContext::run_depth_exchanges( const std::string& label, HaloExchange& halo,
+                                                     const std::vector< moab::Tag >& tags, const int nruns )
+{
+    const int numLayers = halo.num_layers();
+    for( int depth = 1; depth <= numLayers; ++depth )
+    {
+        halo.reset_timers();
+        timer_push( "Exchange " + label + " tag data, ghost layers 1-" + std::to_string( depth ) + " of " +
+                    std::to_string( numLayers ) );
+        for( int irun = 0; irun < nruns; ++irun )
+            runchk( halo.exchange( tags, depth ), "Exchange of " << label << " tag at depth " << depth << " failed" );
+        timer_pop( nruns );
+
+        // Bytes received per exchange: [total, max per rank]
+        size_t inPlace = 0, total = 0;
+        halo.received_bytes( inPlace, total );
+        const unsigned long long local = total / nruns;
+        unsigned long long sumBytes    = 0, maxBytes = 0;
+        MPI_Reduce( &local, &sumBytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, parallel_communicator->comm() );
+        MPI_Reduce( &local, &maxBytes, 1, MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, parallel_communicator->comm() );
+        if( proc_id == 0 )
+            std::cout << "    Bytes received per " << label << " exchange at depth " << depth
+                      << ": total = " << sumBytes << ", max per rank = " << maxBytes << std::endl;
+    }
+    return moab::MB_SUCCESS;
+}
+
+/// @brief Custom reduction of the verification: add the square of every contribution
+static double add_square( double owned, double contribution )
+{
+    return owned + contribution * contribution;
+}
+
+moab::ErrorCode RuntimeContext::run_reductions( HaloExchange& halo, const moab::Range& entities, const int nruns )
+{
+    // Contribution tags, so that the analytical fields are left untouched
+    moab::Tag tagScalar = nullptr, tagVector = nullptr;
+    double defValue     = 0.0;
+    runchk( moab_interface->tag_get_handle( "reduce_scalar", 1, moab::MB_TYPE_DOUBLE, tagScalar,
+                                            moab::MB_TAG_CREAT | moab::MB_TAG_DENSE, &defValue ),
+            "Retrieving scalar contribution tag handle failed" );
+    runchk( moab_interface->tag_get_handle( "reduce_vector", vector_length, moab::MB_TYPE_DOUBLE, tagVector,
+                                            moab::MB_TAG_CREAT | moab::MB_TAG_DENSE, &defValue ),
+            "Retrieving vector contribution tag handle failed" );
+
+    // Every copy contributes (rank + 1) * (component + 1) * weight, where the weight of an entity derives
+    // from its handle on the owner (the same on all the copies). The owner also lists the ranks holding
+    // a copy of each of its entities
+    const size_t nents = entities.size();
+    std::vector< double > weights( nents );
+    std::vector< std::vector< int > > copyRanks( nents );
+    int sharingProcs[MAX_SHARING_PROCS];
+    moab::EntityHandle sharingHandles[MAX_SHARING_PROCS];
+    unsigned char pstatus;
+    int numSharing = 0;
+    size_t index   = 0;
+    for( auto it = entities.begin(); it != entities.end(); ++it, ++index )
+    {
+        int owner                      = -1;
+        moab::EntityHandle ownerHandle = 0;
+        runchk( parallel_communicator->get_owner_handle( *it, owner, ownerHandle ), "Getting the entity owner failed" );
+        weights[index] = 1.0 + static_cast< double >( moab_interface->id_from_handle( ownerHandle ) % 64 );
+        if( owner != proc_id ) continue;
+        copyRanks[index].push_back( proc_id );
+        runchk( parallel_communicator->get_sharing_data( *it, sharingProcs, sharingHandles, pstatus, numSharing ),
+                "Getting the entity sharing data failed" );
+        for( int ip = 0; ip < numSharing; ++ip )
+            if( sharingProcs[ip] >= 0 && sharingProcs[ip] != proc_id ) copyRanks[index].push_back( sharingProcs[ip] );
+    }
+    auto contribution = [&]( int rank, size_t ie, int ic ) { return ( rank + 1.0 ) * ( ic + 1.0 ) * weights[ie]; };
+
+    std::vector< double > values;
+    auto set_contributions = [&]( moab::Tag tag, int ncomp ) {
+        values.resize( nents * ncomp );
+        for( size_t ie = 0; ie < nents; ++ie )
+            for( int ic = 0; ic < ncomp; ++ic )
+                values[ie * ncomp + ic] = contribution( proc_id, ie, ic );
+        return moab_interface->tag_set_data( tag, entities, values.data() );
+    };
+
+    const std::pair< moab::Tag, std::string > fields[] = { { tagScalar, "scalar" }, { tagVector, "vector" } };
+    for( auto& field : fields )
+    {
+        const std::vector< moab::Tag > tags( 1, field.first );
+        const int ncomp = ( field.first == tagScalar ) ? 1 : vector_length;
+
+        // Timing of the sums (the owned values keep growing, which does not change the cost)
+        runchk( set_contributions( field.first, ncomp ), "Setting the contributions failed" );
+        timer_push( "Reduce " + field.second + " tag data (sum)" );
+        for( int irun = 0; irun < nruns; ++irun )
+            runchk( halo.reduce( tags, HaloExchange::REDUCE_SUM ), "Reduction of " << field.second << " tag failed" );
+        timer_pop( nruns );
+        runchk( set_contributions( field.first, ncomp ), "Setting the contributions failed" );
+        timer_push( "Reduce " + field.second + " tag data (sum) with ParallelComm::reduce_tags" );
+        for( int irun = 0; irun < nruns; ++irun )
+            runchk( parallel_communicator->reduce_tags( tags, tags, MPI_SUM, entities ),
+                    "ParallelComm reduction of " << field.second << " tag failed" );
+        timer_pop( nruns );
+
+        // Verification of every operator against the analytic reduction on the owned entities
+        const HaloExchange::ReduceOp ops[] = { HaloExchange::REDUCE_SUM, HaloExchange::REDUCE_MIN,
+                                               HaloExchange::REDUCE_MAX, HaloExchange::REDUCE_CUSTOM };
+        const char* opNames[]              = { "sum", "min", "max", "sum of squares" };
+        for( auto op : ops )
+        {
+            runchk( set_contributions( field.first, ncomp ), "Setting the contributions failed" );
+            runchk( halo.reduce( tags, op, add_square ), "Reduction of " << field.second << " tag failed" );
+            runchk( moab_interface->tag_get_data( field.first, entities, values.data() ),
+                    "Getting the reduced values failed" );
+
+            unsigned long long local[2] = { 0, 0 }, global[2] = { 0, 0 };  // [checked, mismatches]
+            for( size_t ie = 0; ie < nents; ++ie )
+            {
+                if( copyRanks[ie].empty() ) continue;  // not owned
+                for( int ic = 0; ic < ncomp; ++ic )
+                {
+                    double expected = contribution( copyRanks[ie][0], ie, ic );
+                    for( size_t ir = 1; ir < copyRanks[ie].size(); ++ir )
+                    {
+                        const double value = contribution( copyRanks[ie][ir], ie, ic );
+                        if( op == HaloExchange::REDUCE_SUM )
+                            expected += value;
+                        else if( op == HaloExchange::REDUCE_MIN )
+                            expected = std::min( expected, value );
+                        else if( op == HaloExchange::REDUCE_MAX )
+                            expected = std::max( expected, value );
+                        else
+                            expected = add_square( expected, value );
+                    }
+                    ++local[0];
+                    if( std::fabs( values[ie * ncomp + ic] - expected ) > 1.0e-12 * std::fabs( expected ) ) ++local[1];
+                }
+            }
+            MPI_Reduce( local, global, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, parallel_communicator->comm() );
+            if( proc_id == 0 )
+                std::cout << "    Verification of " << field.second << " reduction (" << opNames[op]
+                          << "): " << global[0] << " owned values, " << global[1] << " mismatches"
+                          << ( global[1] ? " -- FAILED" : "" ) << std::endl;
+        }
+    }
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode RuntimeContext::run_comm_avoiding( HaloExchange& halo, moab::Tag tagInitial, const moab::Range& cells,
+                                                   const std::vector< int >& layers, const CellAdjacency& adjacency,
+                                                   const int nsteps )
+{
+    const int numLayers = halo.num_layers();
+    if( numLayers < 1 || layers.size() != cells.size() )
+    {
+        if( proc_id == 0 )
+            std::cout << "Warning:: Communication-avoiding steps need the ghost layer of every cell; skipped"
+                      << std::endl;
+        return moab::MB_SUCCESS;
+    }
+
+    // Working field, so that the analytical field is left untouched
+    moab::Tag tagField = nullptr;
+    double defValue    = 0.0;
+    runchk( moab_interface->tag_get_handle( "ca_scalar", 1, moab::MB_TYPE_DOUBLE, tagField,
+                                            moab::MB_TAG_CREAT | moab::MB_TAG_DENSE, &defValue ),
+            "Retrieving communication-avoiding field tag handle failed" );
+    const size_t ncells = cells.size();
+    std::vector< double > initial( ncells );
+    runchk( moab_interface->tag_get_data( tagInitial, cells, initial.data() ), "Getting the initial field failed" );
+    std::vector< double* > value( ncells );
+    size_t index = 0;
+    for( auto it = cells.begin(); it != cells.end(); )
+    {
+        int count  = 0;
+        void* data = nullptr;
+        runchk( moab_interface->tag_iterate( tagField, it, cells.end(), count, data ),
+                "Iterating over dense tag storage failed" );
+        for( int ie = 0; ie < count; ++ie, ++index )
+            value[index] = static_cast< double* >( data ) + ie;
+        it += count;
+    }
+
+    // Step s of a cycle of k steps only updates the cells of layers 0..k-s: their neighbors are still
+    // valid, and the outer layers are not read again before the next exchange overwrites them
+    std::vector< std::vector< int > > active( numLayers );
+    for( int depth = 0; depth < numLayers; ++depth )
+        for( size_t ic = 0; ic < ncells; ++ic )
+            if( layers[ic] <= depth ) active[depth].push_back( static_cast< int >( ic ) );
+    const size_t nowned = active[0].size();
+
+    // The same number of steps for every k: a multiple of 1..N
+    int period = 1;
+    for( int k = 2; k <= numLayers; ++k )
+        period = period / std::gcd( period, k ) * k;
+    const int totalSteps = std::max( 1, ( nsteps + period - 1 ) / period ) * period;
+
+    const double nu = 0.1;
+    const std::vector< moab::Tag > tags( 1, tagField );
+    std::vector< double > next( ncells ), reference( nowned );
+    const int* offsets   = adjacency.offsets.data();
+    const int* neighbors = adjacency.neighbors.data();
+    for( int k = 1; k <= numLayers; ++k )
+    {
+        for( size_t ic = 0; ic < ncells; ++ic )
+            *value[ic] = initial[ic];
+
+        double compute = 0.0, exchange = 0.0;
+        unsigned long long updates = 0;
+        timer_push( "Communication-avoiding time steps, " + std::to_string( k ) + " per exchange of " +
+                    std::to_string( numLayers ) + " ghost layers" );
+        for( int icycle = 0; icycle < totalSteps / k; ++icycle )
+        {
+            double start = MPI_Wtime();
+            runchk( halo.exchange( tags ), "Exchange of communication-avoiding field failed" );
+            exchange += MPI_Wtime() - start;
+
+            start = MPI_Wtime();
+            for( int step = 1; step <= k; ++step )
+            {
+                const std::vector< int >& cellIds = active[k - step];
+                const int nactive                 = static_cast< int >( cellIds.size() );
+#pragma omp parallel for schedule( static )
+                for( int ia = 0; ia < nactive; ++ia )
+                {
+                    const int icell = cellIds[ia];
+                    double sum      = ( 1.0 - nu * ( offsets[icell + 1] - offsets[icell] ) ) * *value[icell];
+                    for( int in = offsets[icell]; in < offsets[icell + 1]; ++in )
+                        sum += nu * *value[neighbors[in]];
+                    next[icell] = sum;
+                }
+#pragma omp parallel for schedule( static )
+                for( int ia = 0; ia < nactive; ++ia )
+                    *value[cellIds[ia]] = next[cellIds[ia]];
+                updates += nactive;
+            }
+            compute += MPI_Wtime() - start;
+        }
+        timer_pop( totalSteps );
+
+        // Owned values after the same number of steps must not depend on k (up to the summation order
+        // of the ghost updates, which differs from that of their owners)
+        unsigned long long local[2] = { nowned, 0 }, global[2] = { 0, 0 };  // [checked, mismatches]
+        for( size_t io = 0; io < nowned; ++io )
+        {
+            const double owned = *value[active[0][io]];
+            if( k == 1 )
+                reference[io] = owned;
+            else if( std::fabs( owned - reference[io] ) > 1.0e-12 * std::max( 1.0, std::fabs( reference[io] ) ) )
+                ++local[1];
+        }
+        MPI_Reduce( local, global, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0, parallel_communicator->comm() );
+
+        // Per-step times of the slowest rank: [compute, exchange], and the updates per owned cell
+        double localTimes[2] = { compute / totalSteps, exchange / totalSteps }, maxTimes[2] = { 0.0, 0.0 };
+        MPI_Reduce( localTimes, maxTimes, 2, MPI_DOUBLE, MPI_MAX, 0, parallel_communicator->comm() );
+        unsigned long long localUpdates[2] = { updates, static_cast< unsigned long long >( nowned ) * totalSteps },
+                           globalUpdates[2] = { 0, 0 };
+        MPI_Reduce( localUpdates, globalUpdates, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM, 0,
+                    parallel_communicator->comm() );
+        if( proc_id == 0 )
+        {
+            std::cout << "    " << k << " step(s) per exchange: compute = " << maxTimes[0]
+                      << " s/step, exchange = " << maxTimes[1] << " s/step, total = " << maxTimes[0] + maxTimes[1]
+                      << " s/step, exchanges = " << totalSteps / k << ", redundant updates = "
+                      << ( globalUpdates[1] ? static_cast< double >( globalUpdates[0] ) / globalUpdates[1] - 1.0
+                                            : 0.0 ) * 100.0
+                      << "%" << std::endl;
+            if( k > 1 )
+                std::cout << "    Verification against 1 step per exchange: " << global[0] << " owned values, "
+                          << global[1] << " mismatches" << ( global[1] ? " -- FAILED" : "" ) << std::endl;
+        }
+    }
+    return moab::MB_SUCCESS;
+}
+
+/// @brief Cross product c = a x b of 3D vectors
+static void cross3( const double* a, const double* b, double* c )
+{
+    c[0] = a[1] * b[2] - a[2] * b[1];
+    c[1] = a[2] * b[0] - a[0] * b[2];
+    c[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+/// @brief Dot product of 3D vectors
+static double dot3( const double* a, const double* b )
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+/// @brief Scale a 3D vector to unit length
+static void normalize3( double* a )
+{
+    const double norm = std::sqrt( dot3( a, a ) );
+    if( norm > 0.0 )
+        for( int ic = 0; ic < 3; ++ic )
+            a[ic] /= norm;
+}
+
+/// @brief Great-circle angle between two unit vectors
+static double arc3( const double* a, const double* b )
+{
+    double axb[3];
+    cross3( a, b, axb );
+    return std::atan2( std::sqrt( dot3( axb, axb ) ), dot3( a, b ) );
+}
+
+moab::ErrorCode RuntimeContext::run_time_loop( HaloExchange& halo, moab::Tag tagInitial, const moab::Range& cells,
+                                               const moab::Range& owned, const CellAdjacency& adjacency,
+                                               const int nsteps )
+{
+    // Working field, so that the analytical field is left untouched
+    moab::Tag tagField = nullptr;
+    double defValue    = 0.0;
+    runchk( moab_interface->tag_get_handle( "timeloop_scalar", 1, moab::MB_TYPE_DOUBLE, tagField,
+                                            moab::MB_TAG_CREAT | moab::MB_TAG_DENSE, &defValue ),
+            "Retrieving time loop field tag handle failed" );
+    const size_t ncells = cells.size();
+    std::vector< double > values( ncells );
+    runchk( moab_interface->tag_get_data( tagInitial, cells, values.data() ), "Getting the initial field failed" );
+    runchk( moab_interface->tag_set_data( tagField, cells, values.data() ), "Setting the time loop field failed" );
+    std::vector< double* > value( ncells );
+    size_t index = 0;
+    for( auto it = cells.begin(); it != cells.end(); )
+    {
+        int count  = 0;
+        void* data = nullptr;
+        runchk( moab_interface->tag_iterate( tagField, it, cells.end(), count, data ),
+                "Iterating over dense tag storage failed" );
+        for( int ie = 0; ie < count; ++ie, ++index )
+            value[index] = static_cast< double* >( data ) + ie;
+        it += count;
+    }
+    std::vector< int > ownedIds;
+    ownedIds.reserve( owned.size() );
+    for( auto it = owned.begin(); it != owned.end(); ++it )
+        ownedIds.push_back( cells.index( *it ) );
+    const int nowned = static_cast< int >( ownedIds.size() );
+
+    // Geometry on the unit sphere: the distinct vertices of every cell (MPAS polygons are padded by
+    // repeating a vertex) and its center, the normalized mean of the vertices
+    std::vector< std::vector< moab::EntityHandle > > cellVerts( ncells );
+    std::vector< double > centers( 3 * ncells, 0.0 ), coords;
+    index = 0;
+    for( auto it = cells.begin(); it != cells.end(); ++it, ++index )
+    {
+        const moab::EntityHandle* conn = nullptr;
+        int nverts                     = 0;
+        runchk( moab_interface->get_connectivity( *it, conn, nverts ), "Getting cell connectivity failed" );
+        for( int iv = 0; iv < nverts; ++iv )
+            if( !iv || ( conn[iv] != conn[iv - 1] && conn[iv] != conn[0] ) ) cellVerts[index].push_back( conn[iv] );
+        coords.resize( 3 * cellVerts[index].size() );
+        runchk( moab_interface->get_coords( cellVerts[index].data(), static_cast< int >( cellVerts[index].size() ),
+                                            coords.data() ),
+                "Getting vertex coordinates failed" );
+        double* center = &centers[3 * index];
+        for( size_t iv = 0; iv < cellVerts[index].size(); ++iv )
+        {
+            normalize3( &coords[3 * iv] );
+            for( int ic = 0; ic < 3; ++ic )
+                center[ic] += coords[3 * iv + ic];
+        }
+        normalize3( center );
+    }
+
+    // Every face of an owned cell i is the edge it shares with a neighbor j. The face terms are
+    // computed from the two edge vertices in handle order and the two cell centers, so that the
+    // ranks holding both cells compute exactly opposite fluxes:
+    //   advection: solid-body zonal wind u0 cos(lat) (east) at the edge midpoint, dot the unit
+    //              normal pointing from i to j, times the edge length
+    //   diffusion: edge length over the distance between the centers
+    // The area of the owned cells is the sum of the spherical triangles (center, edge)
+    const double u0      = 1.0;
+    const int* offsets   = adjacency.offsets.data();
+    const int* neighbors = adjacency.neighbors.data();
+    std::vector< double > advection( adjacency.neighbors.size(), 0.0 ), conductance( adjacency.neighbors.size(), 0.0 );
+    std::vector< double > areas( nowned, 0.0 );
+    double localDistance[2] = { 0.0, 0.0 };  // [sum, count] of the distances between the centers
+    for( int io = 0; io < nowned; ++io )
+    {
+        const int icell                                = ownedIds[io];
+        const double* ci                               = &centers[3 * icell];
+        const std::vector< moab::EntityHandle >& verts = cellVerts[icell];
+        const size_t nverts                            = verts.size();
+        coords.resize( 3 * nverts );
+        runchk( moab_interface->get_coords( verts.data(), static_cast< int >( nverts ), coords.data() ),
+                "Getting vertex coordinates failed" );
+        for( size_t iv = 0; iv < nverts; ++iv )
+            normalize3( &coords[3 * iv] );
+        for( size_t iv = 0; nverts > 2 && iv < nverts; ++iv )
+        {
+            // Spherical excess of the triangle (center, p, q)
+            const double *p = &coords[3 * iv], *q = &coords[3 * ( ( iv + 1 ) % nverts )];
+            double pxq[3];
+            cross3( p, q, pxq );
+            areas[io] += 2.0 * std::atan2( std::fabs( dot3( ci, pxq ) ),
+                                           1.0 + dot3( ci, p ) + dot3( p, q ) + dot3( q, ci ) );
+        }
+
+        for( int in = offsets[icell]; in < offsets[icell + 1]; ++in )
+        {
+            const int jcell                                = neighbors[in];
+            const double* cj                               = &centers[3 * jcell];
+            const std::vector< moab::EntityHandle >& other = cellVerts[jcell];
+            for( size_t iv = 0; iv < nverts; ++iv )
+            {
+                const size_t iw = ( iv + 1 ) % nverts;
+                if( std::find( other.begin(), other.end(), verts[iv] ) == other.end() ||
+                    std::find( other.begin(), other.end(), verts[iw] ) == other.end() )
+                    continue;
+                const double* pa = &coords[3 * ( verts[iv] < verts[iw] ? iv : iw )];
+                const double* pb = &coords[3 * ( verts[iv] < verts[iw] ? iw : iv )];
+                double middle[3], tangent[3], normal[3];
+                for( int ic = 0; ic < 3; ++ic )
+                {
+                    middle[ic]  = pa[ic] + pb[ic];
+                    tangent[ic] = pb[ic] - pa[ic];
+                }
+                normalize3( middle );
+                cross3( tangent, middle, normal );
+                normalize3( normal );
+                const double direction[3] = { cj[0] - ci[0], cj[1] - ci[1], cj[2] - ci[2] };
+                const double sign         = dot3( normal, direction ) < 0.0 ? -1.0 : 1.0;
+                const double wind[3]      = { -u0 * middle[1], u0 * middle[0], 0.0 };
+                const double length       = arc3( pa, pb );
+                const double distance     = arc3( ci, cj );
+                advection[in]             = sign * dot3( wind, normal ) * length;
+                conductance[in]           = distance > 0.0 ? length / distance : 0.0;
+                localDistance[0] += distance;
+                localDistance[1] += 1.0;
+                break;
+            }
+        }
+    }
+
+    // Diffusivity for a cell Peclet number of 2, and the largest stable time step (half of the
+    // explicit upwind limit) on the smallest cell of all the ranks
+    double globalDistance[2] = { 0.0, 0.0 };
+    MPI_Allreduce( localDistance, globalDistance, 2, MPI_DOUBLE, MPI_SUM, parallel_communicator->comm() );
+    const double kappa = globalDistance[1] > 0.0 ? 0.5 * u0 * globalDistance[0] / globalDistance[1] : 0.0;
+    double localStep   = std::numeric_limits< double >::max(), timeStep = 0.0;
+    for( int io = 0; io < nowned; ++io )
+    {
+        const int icell = ownedIds[io];
+        double outflow  = 0.0;
+        for( int in = offsets[icell]; in < offsets[icell + 1]; ++in )
+            outflow += std::max( advection[in], 0.0 ) + kappa * conductance[in];
+        if( outflow > 0.0 ) localStep = std::min( localStep, 0.5 * areas[io] / outflow );
+    }
+    MPI_Allreduce( &localStep, &timeStep, 1, MPI_DOUBLE, MPI_MIN, parallel_communicator->comm() );
+    for( auto& conductivity : conductance )
+        conductivity *= kappa;
+
+    // Integral of the field over the sphere: sum of u A over the owned cells
+    auto global_integral = [&]() {
+        double localSum = 0.0, globalSum = 0.0;
+        for( int io = 0; io < nowned; ++io )
+            localSum += *value[ownedIds[io]] * areas[io];
+        MPI_Allreduce( &localSum, &globalSum, 1, MPI_DOUBLE, MPI_SUM, parallel_communicator->comm() );
+        return globalSum;
+    };
+    const double initialIntegral = global_integral();
+
+    const std::vector< moab::Tag > tags( 1, tagField );
+    std::vector< double > next( nowned );
+    double compute = 0.0, exchange = 0.0;
+    timer_push( "Advection-diffusion time loop (" + std::to_string( nsteps ) + " steps)" );
+    for( int istep = 0; istep < nsteps; ++istep )
+    {
+        double start = MPI_Wtime();
+        runchk( halo.exchange( tags ), "Exchange of time loop field failed" );
+        exchange += MPI_Wtime() - start;
+
+        // Upwind advection and diffusion fluxes out of every owned cell, from the ghost values
+        start = MPI_Wtime();
+#pragma omp parallel for schedule( static )
+        for( int io = 0; io < nowned; ++io )
+        {
+            const int icell = ownedIds[io];
+            const double ui = *value[icell];
+            double outflow  = 0.0;
+            for( int in = offsets[icell]; in < offsets[icell + 1]; ++in )
+            {
+                const double uj = *value[neighbors[in]];
+                const double f  = advection[in];
+                outflow += ( f > 0.0 ? f * ui : f * uj ) + conductance[in] * ( ui - uj );
+            }
+            next[io] = ui - timeStep * outflow / areas[io];
+        }
+#pragma omp parallel for schedule( static )
+        for( int io = 0; io < nowned; ++io )
+            *value[ownedIds[io]] = next[io];
+        compute += MPI_Wtime() - start;
+    }
+    timer_pop( nsteps );
+    const double finalIntegral = global_integral();
+
+    // Per-step times of the slowest rank: [compute, exchange, total]
+    double localTimes[3] = { compute / nsteps, exchange / nsteps, ( compute + exchange ) / nsteps };
+    double maxTimes[3]   = { 0.0, 0.0, 0.0 };
+    MPI_Reduce( localTimes, maxTimes, 3, MPI_DOUBLE, MPI_MAX, 0, parallel_communicator->comm() );
+    if( proc_id == 0 )
+    {
+        const double drift =
+            std::fabs( finalIntegral - initialIntegral ) / std::max( 1.0e-300, std::fabs( initialIntegral ) );
+        std::cout << "    Time loop per step: compute = " << maxTimes[0] << " s, exchange = " << maxTimes[1]
+                  << " s, total = " << maxTimes[2] << " s; time to solution = " << maxTimes[2] * nsteps
+                  << " s (time step = " << timeStep << " on the unit sphere)" << std::endl;
+        std::cout << "    Conservation of the field integral: initial = " << std::setprecision( 15 )
+                  << initialIntegral << ", final = " << finalIntegral << std::setprecision( 6 )
+                  << ", relative drift = " << drift << ( drift > 1.0e-10 ? " -- FAILED" : "" ) << std::endl;
+    }
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode RuntimeContext::tag_regions( const std::vector< moab::Tag >& tags, const moab::Range& entities,
+                                             std::vector< NumaUtils::Region >& regions ) const
+{
+    for( auto tag : tags )
+    {
+        int bytes = 0;
+        runchk( moab_interface->tag_get_bytes( tag, bytes ), "Getting tag size failed" );
+        for( auto it = entities.begin(); it != entities.end(); )
+        {
+            int count  = 0;
+            void* data = nullptr;
+            runchk( moab_interface->tag_iterate( tag, it, entities.end(), count, data ),
+                    "Iterating over dense tag storage failed" );
+            regions.push_back( { data, static_cast< size_t >( count ) * bytes } );
+            it += count;
+        }
+    }
+    return moab::MB_SUCCESS;
+}
+
+void RuntimeContext::place_numa( const std::string& label, const std::vector< NumaUtils::Region >& regions,
+                                 const bool migrate ) const
+{
+    // Percentage of the resident pages that are on the node of this rank (-1 if unknown)
+    const int node   = NumaUtils::current_node();
+    auto local_pages = [&]() {
+        std::vector< size_t > pagesPerNode;
+        if( node < 0 || !NumaUtils::page_nodes( regions, pagesPerNode ) ) return -1.0;
+        const size_t total = std::accumulate( pagesPerNode.begin(), pagesPerNode.end(), size_t( 0 ) );
+        return total ? 100.0 * pagesPerNode[node] / total : 100.0;
+    };
+
+    double local[3] = { local_pages(), 0.0, 0.0 };  // [local % before, local % after, edge pages not moved]
+    // Migrating is pointless on a single node; the rank keeps running on the same node afterwards
+    const bool moved = migrate && NumaUtils::num_nodes() > 1 && local[0] >= 0.0 && local[0] < 100.0;
+    size_t edgePages = 0;
+    if( moved && !NumaUtils::move_to_node( regions, node, edgePages ) && proc_id == 0 )
+        std::cout << "    Warning: migrating the " << label << " pages failed on the root rank" << std::endl;
+    local[1] = moved ? local_pages() : local[0];
+    local[2] = static_cast< double >( edgePages );
+
+    double minLocal[3], sumLocal[3];
+    MPI_Reduce( local, minLocal, 3, MPI_DOUBLE, MPI_MIN, 0, parallel_communicator->comm() );
+    MPI_Reduce( local, sumLocal, 3, MPI_DOUBLE, MPI_SUM, 0, parallel_communicator->comm() );
+    if( proc_id != 0 ) return;
+
+    std::cout << "    NUMA placement of " << label << " (" << NumaUtils::num_nodes() << " nodes): ";
+    if( minLocal[0] < 0.0 )
+        std::cout << "not available on all ranks" << std::endl;
+    else if( migrate )
+        std::cout << "local pages before = " << sumLocal[0] / num_procs << "% (min " << minLocal[0]
+                  << "%), after migration = " << sumLocal[1] / num_procs << "% (min " << minLocal[1]
+                  << "%), partial edge pages not moved = " << sumLocal[2] << std::endl;
+    else
+        std::cout << "local pages = " << sumLocal[0] / num_procs << "% (min " << minLocal[0] << "%)" << std::endl;
+}
+
+void RuntimeContext::measure_baselines()
 {
-    double node[3];
-    std::vector< double > eCentroids( entities.size() * 2 );  // [lon, lat]
-    size_t offset = 0;
-    for( auto entity : entities )
+    MPI_Comm comm = parallel_communicator->comm();
+
+    // Pairwise ping-pong between ranks (2k, 2k+1); all pairs run concurrently so that
+    // the measurement includes the contention of a fully loaded node
+    const int partner = ( proc_id ^ 1 ) < num_procs ? ( proc_id ^ 1 ) : -1;
+    auto one_way_time  = [&]( const int nbytes ) {
+        const int nreps = 20;
+        std::vector< char > buffer( nbytes, 0 );
+        double elapsed = 0.0;
+        MPI_Barrier( comm );
+        if( partner < 0 ) return elapsed;
+        for( int irep = -1; irep < nreps; ++irep )  // first iteration is a warm-up
+        {
+            const double tStart = MPI_Wtime();
+            if( proc_id % 2 == 0 )
+            {
+                MPI_Send( buffer.data(), nbytes, MPI_CHAR, partner, 0, comm );
+                MPI_Recv( buffer.data(), nbytes, MPI_CHAR, partner, 0, comm, MPI_STATUS_IGNORE );
+            }
+            else
+            {
+                MPI_Recv( buffer.data(), nbytes, MPI_CHAR, partner, 0, comm, MPI_STATUS_IGNORE );
+                MPI_Send( buffer.data(), nbytes, MPI_CHAR, partner, 0, comm );
+            }
+            if( irep >= 0 ) elapsed += MPI_Wtime() - tStart;
+        }
+        return elapsed / ( 2.0 * nreps );
+    };
+    const int largeMessage = 4 * 1024 * 1024;
+    double localNetwork[3] = { one_way_time( 8 ), 0.0, partner < 0 ? 0.0 : 1.0 };
+    const double largeTime = one_way_time( largeMessage );
+    localNetwork[1]        = largeTime > 0.0 ? largeMessage / largeTime : 0.0;
+
+    // STREAM triad on arrays much larger than the last-level cache
+    const size_t nvalues = 4 * 1024 * 1024;
+    std::vector< double > a( nvalues, 0.0 ), b( nvalues, 1.0 ), c( nvalues, 2.0 );
+    double bestTime = 0.0;
+    MPI_Barrier( comm );
+    for( int itrial = 0; itrial < 5; ++itrial )
     {
-        // Get the element coordinates (centroid) on the real mesh
-        runchk_cont( moab_interface->get_coords( &entity, 1, node ), "Getting entity coordinates failed" );
+        const double tStart = MPI_Wtime();
+        for( size_t i = 0; i < nvalues; ++i )
+            a[i] = b[i] + 3.0 * c[i];
+        const double elapsed = MPI_Wtime() - tStart;
+        if( itrial == 0 || elapsed < bestTime ) bestTime = elapsed;
+        std::swap( a, b );
+    }
+    double localMemory = ( bestTime > 0.0 && b[nvalues / 2] > 0.0 ) ? 3.0 * nvalues * sizeof( double ) / bestTime
+                                                                   : 0.0;
+
+    // Average over all ranks (the network numbers only over the ranks that had a partner)
+    double sumNetwork[3] = { 0.0, 0.0, 0.0 }, sumMemory = 0.0;
+    MPI_Allreduce( localNetwork, sumNetwork, 3, MPI_DOUBLE, MPI_SUM, comm );
+    MPI_Allreduce( &localMemory, &sumMemory, 1, MPI_DOUBLE, MPI_SUM, comm );
+    baseline.latency           = sumNetwork[2] > 0.0 ? sumNetwork[0] / sumNetwork[2] : 0.0;
+    baseline.network_bandwidth = sumNetwork[2] > 0.0 ? sumNetwork[1] / sumNetwork[2] : 0.0;
+    baseline.memory_bandwidth  = sumMemory / num_procs;
+
+    if( proc_id == 0 )
+        std::cout << "[BASELINE] ping-pong latency = " << baseline.latency * 1e6
+                  << " us, ping-pong bandwidth = " << baseline.network_bandwidth / 1e9
+                  << " GB/s, STREAM triad bandwidth per rank = " << baseline.memory_bandwidth / 1e9 << " GB/s"
+                  << std::endl;
+}
 
-        // scale by magnitude so that element is on unit sphere
-        double magnitude = std::sqrt( node[0] * node[0] + node[1] * node[1] + node[2] * node[2] );
-        node[0] /= magnitude;
-        node[1] /= magnitude;
-        node[2] /= magnitude;
+void RuntimeContext::report_roofline( const std::string& label, const HaloExchange& halo, const int ncomp,
+                                      const double elapsed ) const
+{
+    // Per-rank payload: [bytes sent, messages sent]
+    double localPattern[2] = { static_cast< double >( halo.num_send_entities() * ncomp * sizeof( double ) ), 0.0 };
+    for( auto& nbr : halo.neighbors() )
+        if( !nbr.send_ids.empty() ) localPattern[1] += 1.0;
+    std::vector< double > allPattern( proc_id == 0 ? 2 * num_procs : 0 );
+    MPI_Gather( localPattern, 2, MPI_DOUBLE, allPattern.data(), 2, MPI_DOUBLE, 0, parallel_communicator->comm() );
+    if( proc_id != 0 ) return;
 
-        // compute the spherical transformation onto unit sphere
-        eCentroids[offset] = atan2( node[1], node[0] );
-        if( eCentroids[offset] < 0.0 ) eCentroids[offset] += 2.0 * M_PI;
-        eCentroids[offset + 1] = asin( node[2] );
+    // Latency-bandwidth model per rank: messages * latency + bytes / network bandwidth, plus the
+    // memory traffic of packing and unpacking (read + write on both sides); the slowest rank bounds
+    // the achievable time of the exchange
+    double totalBytes = 0.0, totalMessages = 0.0, maxBytes = 0.0, maxMessages = 0.0;
+    double modelTime = 0.0, modelLatency = 0.0, modelBandwidth = 0.0, modelCopy = 0.0;
+    for( int rank = 0; rank < num_procs; ++rank )
+    {
+        const double bytes = allPattern[2 * rank], messages = allPattern[2 * rank + 1];
+        totalBytes += bytes;
+        totalMessages += messages;
+        maxBytes    = std::max( maxBytes, bytes );
+        maxMessages = std::max( maxMessages, messages );
 
-        offset += 2;  // increment the offset
+        const double latencyTerm   = messages * baseline.latency;
+        const double bandwidthTerm = baseline.network_bandwidth > 0.0 ? bytes / baseline.network_bandwidth : 0.0;
+        const double copyTerm      = baseline.memory_bandwidth > 0.0 ? 4.0 * bytes / baseline.memory_bandwidth : 0.0;
+        if( latencyTerm + bandwidthTerm + copyTerm > modelTime )
+        {
+            modelTime      = latencyTerm + bandwidthTerm + copyTerm;
+            modelLatency   = latencyTerm;
+            modelBandwidth = bandwidthTerm;
+            modelCopy      = copyTerm;
+        }
     }
-    // return centroid list for elements
-    return eCentroids;
+    if( elapsed <= 0.0 ) return;
+
+    std::cout << "[ROOFLINE] " << label << " exchange (" << ncomp << " components)\n"
+              << "    payload per rank: avg = " << totalBytes / num_procs / 1e6 << " MB, max = " << maxBytes / 1e6
+              << " MB; messages per rank: avg = " << totalMessages / num_procs << ", max = " << maxMessages << "\n"
+              << "    bandwidth: per rank avg = " << totalBytes / num_procs / elapsed / 1e9
+              << " GB/s, max = " << maxBytes / elapsed / 1e9 << " GB/s, aggregate = " << totalBytes / elapsed / 1e9
+              << " GB/s; message rate: aggregate = " << totalMessages / elapsed << " msgs/s\n"
+              << "    model (slowest rank): latency = " << modelLatency << " s, bandwidth = " << modelBandwidth
+              << " s, pack/unpack = " << modelCopy << " s\n"
+              << "    percent of achievable = " << std::fixed << std::setprecision( 1 ) << 100.0 * modelTime / elapsed
+              << "%, " << ( modelLatency >= modelBandwidth + modelCopy ? "latency" : "bandwidth" ) << "-bound"
+              << std::defaultfloat << std::setprecision( 6 ) << std::endl;
 }
@@ -13,10 +13,18 @@
 #include "moab/ParallelComm.hpp"
 #include "MBParallelConventions.h"
 
+// Example includes
+#include "FieldFunctions.hpp"
+#include "NumaUtils.hpp"
+#include "PerfCounters.hpp"
+#include "TraceRecorder.hpp"
+
 // C++ includes
 #include <iostream>
 #include <string>
 
+class HaloExchange;
+
 #define dbgprint( MSG )                                           \
     do                                                            \
     {                                                             \
@@ -44,29 +52,68 @@
 struct RuntimeContext
 {
   public:
-    int dimension{ 2 };           /// dimension of the problem
-    std::string input_filename;   /// input file name (nc format)
-    std::string output_filename;  /// output file name (h5m format)
-    int ghost_layers{ 3 };        /// number of ghost layers
-    std::string scalar_tagname;   /// scalar tag name
-    std::string vector_tagname;   /// vector tag name
-    int vector_length{ 3 };       /// length of the vector tag components
-    int num_max_exchange{ 10 };   /// total number of exchange iterations
-    bool debug_output{ false };   /// write debug output information?
-    int proc_id{ 1 };             /// process identifier
-    int num_procs{ 1 };           /// total number of processes
-    double last_counter{ 0.0 };   /// last time counter between push/pop timer
+    int dimension{ 2 };              /// dimension of the problem
+    std::string input_filename;      /// input file name (nc format)
+    std::string output_filename;     /// output file name (h5m format)
+    int ghost_layers{ 3 };           /// number of ghost layers
+    std::string scalar_tagname;      /// scalar tag name
+    std::string vector_tagname;      /// vector tag name
+    std::string scalar_field;        /// analytical field used for the scalar tag
+    std::string vector_field;        /// analytical field used for the vector tag
+    int vector_length{ 3 };          /// length of the vector tag components
+    bool sfc_reorder{ false };       /// renumber the local cells along a Hilbert curve before the ghost setup?
+    bool soa_layout{ false };        /// store the vector field as one single-component tag per level (SoA)?
+    int stencil_sweeps{ 0 };         /// number of stencil sweeps to time on the vector field
+    int num_max_exchange{ 10 };      /// total number of exchange iterations
+    bool debug_output{ false };      /// write debug output information?
+    bool imbalance_report{ false };  /// report per-rank load imbalance of the exchange phases?
+    bool perf_counters{ false };     /// measure hardware performance counters for every timed phase?
+    bool roofline_report{ false };   /// report bandwidth and message rate against a measured baseline?
+    bool mpi_baseline{ false };      /// replay the exchange pattern with raw MPI to measure the overhead?
+    bool pack_datatypes{ false };    /// also time the halo engine with MPI derived datatype packing?
+    bool huge_pages{ false };        /// back the halo engine buffers with transparent huge pages?
+    bool numa_placement{ false };    /// migrate tag and buffer memory to the local NUMA node and report placement?
+    bool recv_in_place{ false };     /// receive contiguous ghost runs directly into tag storage?
+    bool thread_multiple{ false };   /// also time the halo engine with all threads communicating?
+    int partition_bytes{ 0 };        /// partition size of the MPI-4 partitioned exchanges (0 = not timed)
+    int chunk_bytes{ 0 };            /// chunk size of the pipelined exchanges (0 = not timed)
+    bool progress_thread{ false };   /// measure the compute/exchange overlap with a progress thread?
+    int progress_cpu{ -1 };          /// CPU of the progress thread (-1 = last CPU of the rank)
+    bool coroutines{ false };        /// compare concurrent coroutine exchanges with sequential exchanges?
+    bool reduce_exchange{ false };   /// time and verify the reverse (reduction) exchange?
+    bool depth_exchange{ false };    /// time the exchanges of the first 1..N ghost layers?
+    bool comm_avoiding{ false };     /// time k stencil steps per exchange of all the ghost layers, k = 1..N?
+    int time_steps{ 0 };             /// number of advection-diffusion time steps alternating with exchanges
+    bool adjacency_cache{ false };   /// build and report the adjacency of the owned and ghosted cells?
+    bool threaded_graph{ false };    /// build the cell adjacency with OpenMP threads?
+    std::string trace_filename;      /// Chrome trace output file name (empty = no tracing)
+    int trace_capacity{ 65536 };     /// maximum number of trace events kept per rank
+    int proc_id{ 1 };                /// process identifier
+    int num_procs{ 1 };              /// total number of processes
+    double last_counter{ 0.0 };      /// last time counter between push/pop timer
+
+    /// @brief Achievable point-to-point and memory performance measured at startup
+    struct Baseline
+    {
+        double latency{ 0.0 };            /// one-way ping-pong latency of small messages (s)
+        double network_bandwidth{ 0.0 };  /// one-way ping-pong bandwidth of large messages (bytes/s)
+        double memory_bandwidth{ 0.0 };   /// STREAM triad bandwidth per rank with all ranks active (bytes/s)
+    } baseline;
 
     // MOAB objects
     moab::Interface* moab_interface{ nullptr };
     moab::ParallelComm* parallel_communicator{ nullptr };
     moab::EntityHandle fileset{ 0 }, partnset{ 0 };
 
+    // Event recorder (enabled with --trace)
+    TraceRecorder tracer;
+
     /// @brief Constructor: allocate MOAB interface and communicator, and initialize
     /// other data members with some default values
     RuntimeContext( MPI_Comm comm = MPI_COMM_WORLD )
         : input_filename( "data/default_mesh_holes.h5m" ), output_filename( "exchangeHalos_output.h5m" ),
-          scalar_tagname( "scalar_variable" ), vector_tagname( "vector_variable" )
+          scalar_tagname( "scalar_variable" ), vector_tagname( "vector_variable" ), scalar_field( "harmonic16" ),
+          vector_field( "harmonic2" )
     {
         // Create the moab instance
         moab_interface = new( std::nothrow ) moab::Core;
@@ -107,13 +154,138 @@ struct RuntimeContext
         // Dimension of the input mesh
         // Vector tag length
         opts.addOpt< int >( "vtaglength", "Size of vector components per each entity. Default=3", &vector_length );
+        // Space-filling curve renumbering of the local cells
+        opts.addOpt< void >( "reorder",
+                             "Renumber the local cells along a Hilbert curve of their centroids before creating the "
+                             "ghost layers, to improve the locality of stencils and packing. Default=false",
+                             &sfc_reorder );
+        // Memory layout of the vector field
+        opts.addOpt< void >( "soa",
+                             "Store the vector field as vtaglength single-component tags (SoA) instead of one "
+                             "vtaglength-component tag (AoS). Default=false",
+                             &soa_layout );
+        // Representative horizontal stencil on the vector field
+        opts.addOpt< int >( "stencil",
+                            "Number of stencil sweeps to time on the vector field after the exchanges. Default=0",
+                            &stencil_sweeps );
+        // Analytical fields used to initialize the tags
+        opts.addOpt< std::string >( "sfield",
+                                    "Analytical field for the scalar tag: " + FieldFunctions::all_names() +
+                                        ". Default=harmonic16",
+                                    &scalar_field );
+        opts.addOpt< std::string >( "vfield",
+                                    "Analytical field for the vector tag: " + FieldFunctions::all_names() +
+                                        ". Default=harmonic2",
+                                    &vector_field );
         // Number of halo (ghost) regions
         opts.addOpt< int >( "nghosts", "Number of ghost layers (halos) to exchange. Default=3", &ghost_layers );
         // Number of times to perform the halo exchange for timing
         opts.addOpt< int >( "nexchanges", "Number of ghost-halo exchange iterations to perform. Default=10",
                             &num_max_exchange );
+        // Per-rank phase timing and load-imbalance analysis of the exchanges
+        opts.addOpt< void >( "imbalance",
+                             "Record per-rank exchange phase times and report load imbalance. Default=false",
+                             &imbalance_report );
+        // Hardware performance counters (Linux perf_event) around the timed phases
+        opts.addOpt< void >( "perfcounters",
+                             "Collect cycles, instructions, LLC and dTLB misses for each timed phase. Default=false",
+                             &perf_counters );
+        // Bandwidth and message-rate summary against measured machine baselines
+        opts.addOpt< void >( "roofline",
+                             "Measure ping-pong and STREAM baselines at startup and report the achieved bandwidth and "
+                             "message rate of the exchanges against them. Default=false",
+                             &roofline_report );
+        // Raw MPI point-to-point replay of the halo pattern
+        opts.addOpt< void >( "baseline",
+                             "Replay the exchange pattern with raw MPI_Isend/MPI_Irecv on preallocated buffers and "
+                             "report the framework overhead of exchange_tags. Default=false",
+                             &mpi_baseline );
+        // MPI derived datatypes as pack strategy of the halo engine
+        opts.addOpt< void >( "datatypes",
+                             "Also time the instrumented exchanges sending directly from tag storage with MPI derived "
+                             "datatypes, against explicit pack buffers. Default=false",
+                             &pack_datatypes );
+        // Transparent huge pages for the persistent halo buffers
+        opts.addOpt< void >( "hugepages",
+                             "Back the halo engine send/receive buffers of 2 MB or more with transparent huge pages. "
+                             "Default=false",
+                             &huge_pages );
+        // NUMA placement of the tag data and halo buffers
+        opts.addOpt< void >( "numa",
+                             "Report the NUMA placement of the tag data and halo buffers, and migrate the pages that "
+                             "are not on the node of the rank. Default=false",
+                             &numa_placement );
+        // Zero-copy receives into contiguous ghost storage
+        opts.addOpt< void >( "inplace",
+                             "Receive the halo messages directly into tag storage when the ghosts of a neighbor are "
+                             "contiguous, and report the fraction of ghost bytes received in place. Default=false",
+                             &recv_in_place );
+        // Hybrid MPI+threads halo exchange (the option is also checked before MPI_Init_thread)
+        opts.addOpt< void >( "mpithreads",
+                             "Initialize MPI with MPI_THREAD_MULTIPLE and also time the instrumented exchanges with "
+                             "the neighbors split over the OpenMP threads of every rank. Default=false",
+                             &thread_multiple );
+        // MPI-4 partitioned communication as pack strategy of the halo engine
+        opts.addOpt< int >( "partitions",
+                            "Also time the instrumented exchanges with MPI-4 partitioned messages of about this many "
+                            "bytes, each sent as soon as it is packed. Default=0 (not timed)",
+                            &partition_bytes );
+        // Pipelined exchange of the messages in chunks
+        opts.addOpt< int >( "chunk-bytes",
+                            "Also time the instrumented exchanges with every message split into chunks of about this "
+                            "many bytes, pipelining packing, transfer and unpacking. Default=0 (not timed)",
+                            &chunk_bytes );
+        // Overlap of split-phase exchanges with compute, with and without a progress thread
+        opts.addOpt< void >( "progress",
+                             "Measure how much of a split-phase exchange is hidden behind synthetic compute, without "
+                             "and with a communication progress thread (requires MPI_THREAD_MULTIPLE). Default=false",
+                             &progress_thread );
+        opts.addOpt< int >( "progress-cpu",
+                            "CPU to pin the progress thread to (a spare core or hyperthread), which the rank then "
+                            "does not compute on. Default=-1 (last CPU allowed for the rank)",
+                            &progress_cpu );
+        // Concurrent exchanges driven by coroutines
+        opts.addOpt< void >( "coroutines",
+                             "Compare the scalar and vector exchanges run concurrently as C++20 coroutines with the "
+                             "same exchanges run one after the other. Default=false",
+                             &coroutines );
+        // Reverse exchange accumulating the ghost contributions onto the owners
+        opts.addOpt< void >( "reduce",
+                             "Time the reverse exchange (sum of the shared and ghost contributions onto the owners) "
+                             "against ParallelComm::reduce_tags, and verify the sum/min/max/custom reductions. "
+                             "Default=false",
+                             &reduce_exchange );
+        // Exchanges of the first ghost layers only
+        opts.addOpt< void >( "depths",
+                             "Record the ghost layer of every cell during the ghost setup, and time the exchanges of "
+                             "the first 1..N ghost layers only. Default=false",
+                             &depth_exchange );
+        // Communication-avoiding time steps on the ghost layers
+        opts.addOpt< void >( "comm-avoiding",
+                             "Time a diffusion stencil that takes k steps on the shrinking valid region of the ghost "
+                             "layers between exchanges of all the layers, for k = 1..N. Default=false",
+                             &comm_avoiding );
+        // End-to-end time loop: advection-diffusion steps alternating with exchanges
+        opts.addOpt< int >( "timesteps",
+                            "Number of time steps of an advection-diffusion operator on the scalar field, each "
+                            "preceded by a halo exchange, to time and check for conservation. Default=0",
+                            &time_steps );
+        // Adjacency of the owned and ghosted cells, built once after the ghost setup
+        opts.addOpt< void >( "adjacency",
+                             "Build the CSR adjacency of the owned and ghosted cells once after the ghost setup, and "
+                             "report its build time and memory (implied by the stencil options). Default=false",
+                             &adjacency_cache );
+        opts.addOpt< void >( "adjacency-threads", "Build the cell adjacency with OpenMP threads. Default=false",
+                             &threaded_graph );
+        // Event timeline of the run
+        opts.addOpt< std::string >( "trace", "Record an event timeline and write it as Chrome trace JSON to this file",
+                                    &trace_filename );
+        opts.addOpt< int >( "trace-events", "Size of the per-rank trace event ring buffer. Default=65536",
+                            &trace_capacity );
 
         opts.parseCommandLine( argc, argv );
+
+        if( !trace_filename.empty() ) tracer.enable( trace_capacity );
     }
 
     /// @brief Measure and start the timer to profile a task
@@ -122,6 +294,7 @@ struct RuntimeContext
     {
         mTimerOps = mTimer.time_since_birth();
         mOpName   = operation;
+        if( perf_counters ) mCounters.start();
     }
 
     /// @brief Stop the timer and store the elapsed duration
@@ -129,22 +302,36 @@ struct RuntimeContext
     void timer_pop( const int nruns = 1 )
     {
         double locElapsed = mTimer.time_since_birth() - mTimerOps;
+        if( perf_counters ) mCounters.stop();
         double avgElapsed = 0;
-        double maxElapsed = 0;
-        MPI_Reduce( &locElapsed, &maxElapsed, 1, MPI_DOUBLE, MPI_MAX, 0, parallel_communicator->comm() );
+        // use MAXLOC so that we also know which rank was the slowest
+        struct
+        {
+            double value;
+            int rank;
+        } locMax = { locElapsed, proc_id }, maxLoc = { 0.0, 0 };
+        MPI_Reduce( &locMax, &maxLoc, 1, MPI_DOUBLE_INT, MPI_MAXLOC, 0, parallel_communicator->comm() );
         MPI_Reduce( &locElapsed, &avgElapsed, 1, MPI_DOUBLE, MPI_SUM, 0, parallel_communicator->comm() );
         if( proc_id == 0 )
         {
+            const double maxElapsed = maxLoc.value;
             avgElapsed /= num_procs;
             if( nruns > 1 )
                 std::cout << "[LOG] Time taken to " << mOpName.c_str() << ", averaged over " << nruns
-                          << " runs : max = " << maxElapsed / nruns << ", avg = " << avgElapsed / nruns << "\n";
+                          << " runs : max = " << maxElapsed / nruns << ", avg = " << avgElapsed / nruns;
             else
                 std::cout << "[LOG] Time taken to " << mOpName.c_str() << " : max = " << maxElapsed
-                          << ", avg = " << avgElapsed << "\n";
+                          << ", avg = " << avgElapsed;
+            if( imbalance_report ) std::cout << ", slowest rank = " << maxLoc.rank;
+            std::cout << "\n";
 
             last_counter = maxElapsed / nruns;
         }
+        if( perf_counters )
+        {
+            report_counters( mOpName, mCounters, nruns );
+            mCounters.reset();
+        }
         mOpName.clear();
     }
 
@@ -162,20 +349,211 @@ struct RuntimeContext
     /// @return Error code if any (else MB_SUCCESS)
     moab::ErrorCode load_file( bool load_ghosts = false );
 
+    /// @brief Compute the area-weighted centroids of the spherical polygons in 2D lat/lon space,
+    ///        in bulk: the vertex coordinates and element connectivity are accessed in place, chunk
+    ///        by chunk, the centroids are computed with threads (OpenMP), and the projection onto
+    ///        the unit sphere is a vectorizable loop over SoA arrays
+    /// @param entities Entities to compute centroids
+    /// @param centroids Vector of centroids (SoA: [lon[n], lat[n]] for n entities)
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode compute_centroids( const moab::Range& entities, std::vector< double >& centroids ) const;
+
     /// @brief Create scalar and vector tags in the MOAB mesh instance
     /// @param tagScalar Tag reference to the scalar field
-    /// @param tagVector Tag reference to the vector field
-    /// @param entities Entities on which both the scalar and vector fields are defined
+    /// @param tagVector Tags of the vector field: one vector_length-component tag (AoS), or
+    ///        vector_length single-component tags named <vector_tagname>_<level> (SoA)
     /// @return Error code if any (else MB_SUCCESS)
-    moab::ErrorCode create_sv_tags( moab::Tag& tagScalar, moab::Tag& tagVector, moab::Range& entities ) const;
+    moab::ErrorCode create_sv_tags( moab::Tag& tagScalar, std::vector< moab::Tag >& tagVector ) const;
 
-  private:
-    /// @brief Compute the centroids of elements in 2D lat/lon space
-    /// @param entities Entities to compute centroids
-    /// @return Vector of centroids (as lat/lon)
-    std::vector< double > compute_centroids( const moab::Range& entities ) const;
+    /// @brief Set the data of any number of dense double tags with analytical functions evaluated
+    ///        at the entity centroids; the values are written in place into dense tag storage by a
+    ///        thread-parallel kernel (OpenMP), and component k of a vector tag is scaled by (k+1)
+    /// @param tags Tags to initialize
+    /// @param functions Analytical field type used for each tag (FieldFunctions::FieldType)
+    /// @param scales Additional scaling factor of each tag
+    /// @param entities Entities on which the tags are defined
+    /// @param centroids Centroids of the entities (SoA: [lon[n], lat[n]] for n entities)
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode initialize_tags( const std::vector< moab::Tag >& tags, const std::vector< int >& functions,
+                                     const std::vector< double >& scales, const moab::Range& entities,
+                                     const std::vector< double >& centroids ) const;
+
+    /// @brief Cell-to-cell adjacency in compressed sparse row (CSR) format
+    struct CellAdjacency
+    {
+        std::vector< int > offsets;    /// neighbors of cell i are neighbors[offsets[i]] .. neighbors[offsets[i+1]-1]
+        std::vector< int > neighbors;  /// indices of the adjacent cells in the cell range
+    };
+
+    /// Adjacency of the owned and ghosted cells (indices in the ghosted cell range), built once after
+    /// the ghost setup by build_adjacency_cache
+    CellAdjacency cell_adjacency;
+
+    /// @brief Build the adjacency of cells sharing an edge, from the element connectivity, in one pass
+    ///        over the element sequences; the rows are sorted
+    /// @param cells Cells of the graph (indices refer to this range)
+    /// @param adjacency Adjacency of the cells
+    /// @param threaded Gather and sort the edges of the cells with OpenMP threads?
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode build_cell_adjacency( const moab::Range& cells, CellAdjacency& adjacency,
+                                          const bool threaded = false ) const;
+
+    /// @brief Build cell_adjacency for the owned and ghosted cells (threaded on request), and report
+    ///        its build time and memory
+    /// @param cells Owned and ghosted cells, in the order of their dense tag storage
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode build_adjacency_cache( const moab::Range& cells );
+
+    /// @brief Renumber the local cells along a Hilbert curve of their centroids (MOAB ReorderTool), so that
+    ///        the dense tag storage of neighboring cells is close in memory; must be called before the
+    ///        ghost exchange, while the cells are not shared. Prints the mean index distance between
+    ///        adjacent cells before and after the renumbering
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode reorder_cells();
 
+    /// @brief Time sweeps of a diffusion stencil u_i + nu * sum_j( u_j - u_i ) that reads the tag
+    ///        values of a cell and its neighbors in place from dense tag storage and writes the
+    ///        result of the target cells into a buffer with the same layout as the tags (each tag
+    ///        is swept separately, with its components innermost); prints a checksum of the result
+    /// @param label Name of the field used in the report
+    /// @param tags Dense double tags of the field
+    /// @param cells Cells of the adjacency graph (owned and ghosted)
+    /// @param targets Cells on which the stencil is evaluated (subset of cells)
+    /// @param adjacency Adjacency of the cells
+    /// @param nsweeps Number of sweeps to time
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode run_stencil( const std::string& label, const std::vector< moab::Tag >& tags,
+                                 const moab::Range& cells, const moab::Range& targets, const CellAdjacency& adjacency,
+                                 const int nsweeps );
+
+    /// @brief Gather the per-rank phase times of the instrumented halo exchange on the root
+    ///        and print a compact load-imbalance report: phase statistics, the slowest ranks
+    ///        with their neighbor counts and boundary sizes, and whether the slowest rank is
+    ///        persistent (partition imbalance) or changes between exchanges (system noise)
+    /// @param label Name of the exchanged field used in the report
+    /// @param halo Instrumented halo exchange engine holding the accumulated phase times
+    void report_imbalance( const std::string& label, const HaloExchange& halo ) const;
+
+    /// @brief Print the allocation counts of the halo engine buffer pool since its last reset (zero
+    ///        in steady state), along with the buffer capacity and the fraction backed by huge pages
+    /// @param label Name of the exchanged field used in the report
+    /// @param halo Halo exchange engine owning the buffer pool
+    void report_buffers( const std::string& label, const HaloExchange& halo ) const;
+
+    /// @brief Measure how much of a split-phase exchange is hidden behind compute: time the exchange
+    ///        alone, a synthetic compute of the same duration (no MPI calls), and the exchange started
+    ///        before and completed after the compute, and print the fraction of the exchange time that
+    ///        is overlapped (slowest rank)
+    /// @param label Name of the exchanged field used in the report
+    /// @param halo Halo exchange engine (with or without a progress thread)
+    /// @param tags Dense tags to exchange
+    /// @param nruns Number of exchanges to average over
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode report_overlap( const std::string& label, HaloExchange& halo, const std::vector< moab::Tag >& tags,
+                                    const int nruns );
+
+    /// @brief Time the scalar and vector exchanges run one after the other with the blocking exchange,
+    ///        and run concurrently as two coroutines on separate channels of the halo engine, and print
+    ///        the speedup of the concurrent exchanges (slowest rank). Needs a C++20 compiler
+    /// @param halo Halo exchange engine
+    /// @param scalarTags Tags of the scalar field
+    /// @param vectorTags Tags of the vector field
+    /// @param nruns Number of exchanges of each field to average over
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode report_concurrency( HaloExchange& halo, const std::vector< moab::Tag >& scalarTags,
+                                        const std::vector< moab::Tag >& vectorTags, const int nruns );
+
+    /// @brief Time the reverse exchange of the halo engine against ParallelComm::reduce_tags on scalar and
+    ///        vector contribution tags, and verify every reduction operator: each copy of an entity
+    ///        contributes a value depending on its rank, entity and component, so that the reduced owned
+    ///        values can be compared with the analytic reduction over all the ranks holding a copy
+    /// @param halo Halo exchange engine
+    /// @param entities Owned and ghosted entities of the halo engine
+    /// @param nruns Number of reductions to average over
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode run_reductions( HaloExchange& halo, const moab::Range& entities, const int nruns );
+
+    /// @brief Time the exchanges of the first 1..N ghost layers of a field, and report the bytes received
+    ///        per exchange at every depth
+    /// @param label Name of the exchanged field used in the report
+    /// @param halo Halo exchange engine set up with the ghost layers of the cells
+    /// @param tags Dense tags to exchange
+    /// @param nruns Number of exchanges to average over at every depth
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode run_depth_exchanges( const std::string& label, HaloExchange& halo,
+                                         const std::vector< moab::Tag >& tags, const int nruns );
+
+    /// @brief Communication-avoiding time steps: with N ghost layers, a 1-ring diffusion stencil can take
+    ///        k <= N steps between exchanges, step s updating the owned cells and the ghost layers 1..k-s
+    ///        that the later steps of the cycle read. For k = 1..N, time the same number of steps (a multiple
+    ///        of every k) with an exchange of all the layers every k steps, report the compute and
+    ///        exchange time per step and the redundant updates, and verify that the owned values match
+    ///        those of k = 1
+    /// @param halo Halo exchange engine set up with the ghost layers of the cells
+    /// @param tagInitial Scalar tag holding the initial field (left unchanged)
+    /// @param cells Owned and ghosted cells of the halo engine
+    /// @param layers Ghost layer of every cell (0 for the owned cells)
+    /// @param adjacency Adjacency of the cells
+    /// @param nsteps Minimum number of time steps
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode run_comm_avoiding( HaloExchange& halo, moab::Tag tagInitial, const moab::Range& cells,
+                                       const std::vector< int >& layers, const CellAdjacency& adjacency,
+                                       const int nsteps );
+
+    /// @brief Time loop of a conservative finite-volume operator on the owned cells of the unit sphere:
+    ///        upwind advection by a solid-body zonal wind (u.n times the edge length) and diffusion
+    ///        through the cell edges, divided by the cell areas, after an exchange of the ghost values
+    ///        at every step. Reports the compute and exchange time per step of the slowest rank and the
+    ///        time to solution, and checks that the integral of the field (sum of u A) is conserved
+    /// @param halo Halo exchange engine set up on the cells
+    /// @param tagInitial Scalar tag holding the initial field (left unchanged)
+    /// @param cells Owned and ghosted cells of the halo engine
+    /// @param owned Owned cells (subset of cells)
+    /// @param adjacency Adjacency of the cells
+    /// @param nsteps Number of time steps
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode run_time_loop( HaloExchange& halo, moab::Tag tagInitial, const moab::Range& cells,
+                                   const moab::Range& owned, const CellAdjacency& adjacency, const int nsteps );
+
+    /// @brief Collect the memory regions of dense tag storage (allocated if needed) for the entities
+    /// @param tags Dense tags
+    /// @param entities Entities on which the tags are defined
+    /// @param regions Memory regions (one per contiguous chunk of entities and tag)
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode tag_regions( const std::vector< moab::Tag >& tags, const moab::Range& entities,
+                                 std::vector< NumaUtils::Region >& regions ) const;
+
+    /// @brief Report the fraction of the pages of memory regions that reside on the NUMA node of each
+    ///        rank (min and avg over ranks), optionally after migrating them to that node
+    /// @param label Name of the memory used in the report
+    /// @param regions Memory regions of this rank
+    /// @param migrate Move the pages that are on another node to the node of the rank
+    void place_numa( const std::string& label, const std::vector< NumaUtils::Region >& regions,
+                     const bool migrate ) const;
+
+    /// @brief Measure the machine baselines on the communicator: a pairwise ping-pong between
+    ///        neighboring ranks (latency and bandwidth) and a STREAM triad on every rank
+    void measure_baselines();
+
+    /// @brief Print the effective payload bandwidth and message rate of an exchange phase, and
+    ///        compare the measured time to the latency-bandwidth model built from the baselines
+    /// @param label Name of the exchanged field used in the report
+    /// @param halo Halo exchange engine holding the exchange pattern (neighbors and entity counts)
+    /// @param ncomp Number of double components per entity in the exchanged tag
+    /// @param elapsed Measured time per exchange (max over ranks, valid on root)
+    void report_roofline( const std::string& label, const HaloExchange& halo, const int ncomp,
+                          const double elapsed ) const;
+
+    /// @brief Aggregate hardware counters across all ranks (max and avg) and print them on
+    ///        the root along with derived metrics (IPC, LLC and dTLB misses per 1000 instructions)
+    /// @param operation String name of the measured task
+    /// @param counters Counters accumulated over the task on this rank
+    /// @param nruns Optional argument used to average the measured counts
+    void report_counters( const std::string& operation, const PerfCounters& counters, const int nruns = 1 ) const;
+
+  private:
     moab::CpuTimer mTimer;
+    PerfCounters mCounters;
     double mTimerOps{ 0.0 };
     std::string mOpName;
 };
@@ -0,0 +1,302 @@
+// Example Includes
+#include "FieldFunctions.hpp"
+
+// C++ includes
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace FieldFunctions
+{
+/// Physical constants of the Williamson et al. (1992) shallow water test suite
+static const double PI           = 3.14159265358979323846;
+static const double EARTH_RADIUS = 6.37122e6;   /// a (m)
+static const double OMEGA        = 7.292e-5;    /// rotation rate of the earth (1/s)
+static const double GRAVITY      = 9.80616;     /// g (m/s^2)
+
+/// @brief Compute sin(x) and cos(x) together. The argument is reduced to r in [-pi/4, pi/4]
+/// with a two-term Cody-Waite reduction, and both functions are Taylor polynomials in r
+/// (error below 1e-16 on the reduced interval). The quadrant is applied with selects only,
+/// so loops calling this function are vectorized by the compiler.
+static inline void fast_sincos( double x, double& s, double& c )
+{
+    const double twoOverPi = 0.63661977236758134308;
+    const double pio2Hi    = 1.57079632673412561417e+00;  // first 33 bits of pi/2
+    const double pio2Lo    = 6.07710050650619224932e-11;  // pi/2 - pio2Hi
+    const double k         = std::nearbyint( x * twoOverPi );
+    const double r         = ( x - k * pio2Hi ) - k * pio2Lo;
+    const double r2        = r * r;
+
+    const double sinr =
+        r * ( 1.0 + r2 * ( -1.0 / 6.0 +
+                           r2 * ( 1.0 / 120.0 +
+                                  r2 * ( -1.0 / 5040.0 +
+                                         r2 * ( 1.0 / 362880.0 +
+                                                r2 * ( -1.0 / 39916800.0 +
+                                                       r2 * ( 1.0 / 6227020800.0 +
+                                                              r2 * ( -1.0 / 1307674368000.0 ) ) ) ) ) ) ) );
+    const double cosr =
+        1.0 + r2 * ( -0.5 +
+                     r2 * ( 1.0 / 24.0 +
+                            r2 * ( -1.0 / 720.0 +
+                                   r2 * ( 1.0 / 40320.0 +
+                                          r2 * ( -1.0 / 3628800.0 +
+                                                 r2 * ( 1.0 / 479001600.0 +
+                                                        r2 * ( -1.0 / 87178291200.0 +
+                                                               r2 / 20922789888000.0 ) ) ) ) ) ) );
+
+    // quadrant q: (sin, cos) of x = (sinr, cosr), (cosr, -sinr), (-sinr, -cosr), (-cosr, sinr)
+    const int64_t q  = static_cast< int64_t >( k ) & 3;
+    const double sa  = ( q & 1 ) ? cosr : sinr;
+    const double ca  = ( q & 1 ) ? sinr : cosr;
+    s                = ( q & 2 ) ? -sa : sa;
+    c                = ( ( q + 1 ) & 2 ) ? -ca : ca;
+}
+
+static inline double fast_sin( double x )
+{
+    double s, c;
+    fast_sincos( x, s, c );
+    return s;
+}
+
+static inline double fast_cos( double x )
+{
+    double s, c;
+    fast_sincos( x, s, c );
+    return c;
+}
+
+/// @brief Integer power with the exponent known at compile time (unrolled square-and-multiply)
+template < unsigned N >
+static inline double ipow( double x )
+{
+    return ( N % 2 ? x : 1.0 ) * ipow< N / 2 >( x * x );
+}
+template <>
+inline double ipow< 0 >( double )
+{
+    return 1.0;
+}
+
+/// @brief Integer power with a run-time exponent (uniform across the loop)
+static inline double ipow( double x, int n )
+{
+    double result = 1.0;
+    for( ; n > 0; n >>= 1, x *= x )
+        if( n & 1 ) result *= x;
+    return result;
+}
+
+/// @brief Great-circle distance on the unit sphere between (lon, lat) and a center
+static inline double great_circle_distance( double sinLat, double cosLat, double lon, double sinLatC, double cosLatC,
+                                            double lonC )
+{
+    const double cosDist = sinLatC * sinLat + cosLatC * cosLat * fast_cos( lon - lonC );
+    return std::acos( std::min( 1.0, std::max( -1.0, cosDist ) ) );
+}
+
+static void evaluate_harmonic16( const double* lon, const double* lat, double* out, size_t n )
+{
+#pragma omp simd
+    for( size_t i = 0; i < n; ++i )
+        out[i] = 2.0 + ipow< 16 >( fast_sin( 2.0 * lat[i] ) ) * fast_cos( 16.0 * lon[i] );
+}
+
+static void evaluate_harmonic2( const double* lon, const double* lat, double* out, size_t n )
+{
+#pragma omp simd
+    for( size_t i = 0; i < n; ++i )
+    {
+        const double cosLon = fast_cos( lon[i] );
+        out[i]              = 2.0 + cosLon * cosLon * fast_cos( 2.0 * lat[i] );
+    }
+}
+
+static void evaluate_ylm( const double* lon, const double* lat, double* out, size_t n, int l, int m )
+{
+    // orthonormalization: sqrt( (2 - delta_m0) (2l + 1) / (4 pi) (l - m)! / (l + m)! )
+    double factorialRatio = 1.0;
+    for( int k = l - m + 1; k <= l + m; ++k )
+        factorialRatio /= k;
+    const double norm = std::sqrt( ( m == 0 ? 1.0 : 2.0 ) * ( 2 * l + 1 ) / ( 4.0 * PI ) * factorialRatio );
+    // (-1)^m (2m - 1)!!
+    double pmmFactor = 1.0;
+    for( int k = 1; k <= m; ++k )
+        pmmFactor *= -( 2.0 * k - 1.0 );
+
+#pragma omp simd
+    for( size_t i = 0; i < n; ++i )
+    {
+        double x, cosLat;
+        fast_sincos( lat[i], x, cosLat );
+        // associated Legendre function P_l^m(sin(lat)) with the standard upward recurrence in l
+        double pmm = pmmFactor * ipow( cosLat, m );
+        double pl  = pmm;
+        if( l > m )
+        {
+            double plm2 = pmm, plm1 = x * ( 2 * m + 1 ) * pmm;
+            for( int ll = m + 2; ll <= l; ++ll )
+            {
+                const double pll = ( ( 2 * ll - 1 ) * x * plm1 - ( ll + m - 1 ) * plm2 ) / ( ll - m );
+                plm2             = plm1;
+                plm1             = pll;
+            }
+            pl = plm1;
+        }
+        out[i] = norm * pl * fast_cos( m * lon[i] );
+    }
+}
+
+static void evaluate_gaussian_hills( const double* lon, const double* lat, double* out, size_t n )
+{
+    // hmax = 0.95, b = 5, centers at (5 pi / 6, 0) and (7 pi / 6, 0)
+    const double hmax = 0.95, b = 5.0;
+    const double c1[3] = { std::cos( 5.0 * PI / 6.0 ), std::sin( 5.0 * PI / 6.0 ), 0.0 };
+    const double c2[3] = { std::cos( 7.0 * PI / 6.0 ), std::sin( 7.0 * PI / 6.0 ), 0.0 };
+#pragma omp simd
+    for( size_t i = 0; i < n; ++i )
+    {
+        double sinLon, cosLon, sinLat, cosLat;
+        fast_sincos( lon[i], sinLon, cosLon );
+        fast_sincos( lat[i], sinLat, cosLat );
+        const double x = cosLat * cosLon, y = cosLat * sinLon, z = sinLat;
+        const double d1 = ( x - c1[0] ) * ( x - c1[0] ) + ( y - c1[1] ) * ( y - c1[1] ) + ( z - c1[2] ) * ( z - c1[2] );
+        const double d2 = ( x - c2[0] ) * ( x - c2[0] ) + ( y - c2[1] ) * ( y - c2[1] ) + ( z - c2[2] ) * ( z - c2[2] );
+        out[i]          = hmax * ( std::exp( -b * d1 ) + std::exp( -b * d2 ) );
+    }
+}
+
+static void evaluate_cosine_bells( const double* lon, const double* lat, double* out, size_t n )
+{
+    // hmax = 1, radius = 1/2, background b = 0.1, c = 0.9, centers at (5 pi / 6, 0) and (7 pi / 6, 0)
+    const double hmax = 1.0, radius = 0.5, b = 0.1, c = 0.9;
+    const double lon1 = 5.0 * PI / 6.0, lon2 = 7.0 * PI / 6.0;
+#pragma omp simd
+    for( size_t i = 0; i < n; ++i )
+    {
+        double sinLat, cosLat;
+        fast_sincos( lat[i], sinLat, cosLat );
+        const double r1 = great_circle_distance( sinLat, cosLat, lon[i], 0.0, 1.0, lon1 );
+        const double r2 = great_circle_distance( sinLat, cosLat, lon[i], 0.0, 1.0, lon2 );
+        const double h1 = r1 < radius ? 0.5 * hmax * ( 1.0 + fast_cos( PI * r1 / radius ) ) : 0.0;
+        const double h2 = r2 < radius ? 0.5 * hmax * ( 1.0 + fast_cos( PI * r2 / radius ) ) : 0.0;
+        out[i]          = b + c * ( h1 + h2 );
+    }
+}
+
+static void evaluate_williamson1( const double* lon, const double* lat, double* out, size_t n )
+{
+    // h0 = 1000 m, radius = a/3, centered at (3 pi / 2, 0)
+    const double h0 = 1000.0, radius = 1.0 / 3.0, lonC = 1.5 * PI;
+#pragma omp simd
+    for( size_t i = 0; i < n; ++i )
+    {
+        double sinLat, cosLat;
+        fast_sincos( lat[i], sinLat, cosLat );
+        const double r = great_circle_distance( sinLat, cosLat, lon[i], 0.0, 1.0, lonC );
+        out[i]         = r < radius ? 0.5 * h0 * ( 1.0 + fast_cos( PI * r / radius ) ) : 0.0;
+    }
+}
+
+static void evaluate_williamson2( const double* lon, const double* lat, double* out, size_t n, double alpha )
+{
+    // g h0 = 2.94e4 m^2/s^2, u0 = 2 pi a / 12 days
+    const double u0       = 2.0 * PI * EARTH_RADIUS / ( 12.0 * 86400.0 );
+    const double h0       = 2.94e4 / GRAVITY;
+    const double factor   = ( EARTH_RADIUS * OMEGA * u0 + 0.5 * u0 * u0 ) / GRAVITY;
+    const double sinAlpha = std::sin( alpha ), cosAlpha = std::cos( alpha );
+#pragma omp simd
+    for( size_t i = 0; i < n; ++i )
+    {
+        double sinLat, cosLat;
+        fast_sincos( lat[i], sinLat, cosLat );
+        const double term = -fast_cos( lon[i] ) * cosLat * sinAlpha + sinLat * cosAlpha;
+        out[i]            = h0 - factor * term * term;
+    }
+}
+
+static void evaluate_williamson6( const double* lon, const double* lat, double* out, size_t n )
+{
+    // omega = K = 7.848e-6 1/s, R = 4, h0 = 8000 m
+    const int R       = 4;
+    const double w    = 7.848e-6, K = 7.848e-6, h0 = 8000.0;
+    const double scale = EARTH_RADIUS * EARTH_RADIUS / GRAVITY;
+#pragma omp simd
+    for( size_t i = 0; i < n; ++i )
+    {
+        double sinLat, cosLat;
+        fast_sincos( lat[i], sinLat, cosLat );
+        const double c2   = cosLat * cosLat;
+        const double c2R  = ipow< 2 * R >( cosLat );
+        const double c2R2 = ipow< 2 * R - 2 >( cosLat );  // cos^(2R) / cos^2, finite at the poles
+        const double A    = 0.5 * w * ( 2.0 * OMEGA + w ) * c2 +
+                         0.25 * K * K * ( c2R * ( ( R + 1 ) * c2 + ( 2 * R * R - R - 2 ) ) - 2.0 * R * R * c2R2 );
+        const double B = 2.0 * ( OMEGA + w ) * K / ( ( R + 1 ) * ( R + 2 ) ) * ipow< R >( cosLat ) *
+                         ( ( R * R + 2 * R + 2 ) - ( R + 1 ) * ( R + 1 ) * c2 );
+        const double C = 0.25 * K * K * c2R * ( ( R + 1 ) * c2 - ( R + 2 ) );
+        out[i]         = h0 + scale * ( A + B * fast_cos( R * lon[i] ) + C * fast_cos( 2.0 * R * lon[i] ) );
+    }
+}
+
+void evaluate( const double* lon, const double* lat, double* out, size_t n, int type, const FieldParameters& params )
+{
+    switch( type )
+    {
+        case HARMONIC16:
+            evaluate_harmonic16( lon, lat, out, n );
+            break;
+        case YLM:
+            evaluate_ylm( lon, lat, out, n, params.l, std::min( std::max( params.m, 0 ), params.l ) );
+            break;
+        case GAUSSIAN_HILLS:
+            evaluate_gaussian_hills( lon, lat, out, n );
+            break;
+        case COSINE_BELLS:
+            evaluate_cosine_bells( lon, lat, out, n );
+            break;
+        case WILLIAMSON1:
+            evaluate_williamson1( lon, lat, out, n );
+            break;
+        case WILLIAMSON2:
+            evaluate_williamson2( lon, lat, out, n, params.alpha );
+            break;
+        case WILLIAMSON6:
+            evaluate_williamson6( lon, lat, out, n );
+            break;
+        default:
+            evaluate_harmonic2( lon, lat, out, n );
+            break;
+    }
+}
+
+static const char* FIELD_NAMES[NUM_FIELD_TYPES] = { "",
+                                                    "harmonic16",
+                                                    "harmonic2",
+                                                    "ylm",
+                                                    "gaussian_hills",
+                                                    "cosine_bells",
+                                                    "williamson1",
+                                                    "williamson2",
+                                                    "williamson6" };
+
+int type_from_name( const std::string& fieldName )
+{
+    for( int type = HARMONIC16; type < NUM_FIELD_TYPES; ++type )
+        if( fieldName == FIELD_NAMES[type] ) return type;
+    return -1;
+}
+
+const char* name( int type )
+{
+    return ( type >= HARMONIC16 && type < NUM_FIELD_TYPES ) ? FIELD_NAMES[type] : "unknown";
+}
+
+std::string all_names()
+{
+    std::string names;
+    for( int type = HARMONIC16; type < NUM_FIELD_TYPES; ++type )
+        names += ( type > HARMONIC16 ? ", " : "" ) + std::string( FIELD_NAMES[type] );
+    return names;
+}
+}  // namespace FieldFunctions
@@ -0,0 +1,57 @@
+#ifndef __FieldFunctions_hpp_
+#define __FieldFunctions_hpp_
+
+// C++ includes
+#include <cstddef>
+#include <string>
+
+/// @brief Library of analytical test fields on the sphere, evaluated in batches of points.
+/// All the fields are implemented as branch-free loops over structure-of-arrays inputs
+/// (longitude and latitude arrays) so that the compiler can vectorize them; sin/cos and
+/// integer powers use inlined SIMD-friendly implementations instead of libm calls.
+namespace FieldFunctions
+{
+/// @brief Available test fields
+enum FieldType
+{
+    HARMONIC16 = 1,  /// 2 + sin^16(2 lat) cos(16 lon)
+    HARMONIC2,       /// 2 + cos^2(lon) cos(2 lat)
+    YLM,             /// real orthonormal spherical harmonic Y_l^m (l and m from FieldParameters)
+    GAUSSIAN_HILLS,  /// two Gaussian hills (Lauritzen et al. 2012)
+    COSINE_BELLS,    /// two cosine bells with background (Lauritzen et al. 2012)
+    WILLIAMSON1,     /// cosine bell height of Williamson et al. (1992) test case 1
+    WILLIAMSON2,     /// geostrophic balance height of Williamson et al. (1992) test case 2
+    WILLIAMSON6,     /// Rossby-Haurwitz wave height of Williamson et al. (1992) test case 6
+    NUM_FIELD_TYPES
+};
+
+/// @brief Optional parameters of the test fields
+struct FieldParameters
+{
+    int l{ 4 };           /// degree of the spherical harmonic (YLM)
+    int m{ 3 };           /// order of the spherical harmonic (YLM), 0 <= m <= l
+    double alpha{ 0.0 };  /// rotation angle of the flow relative to the pole (WILLIAMSON2)
+};
+
+/// @brief Evaluate a test field at a batch of points
+/// @param lon Longitudes of the points in radians [n]
+/// @param lat Latitudes of the points in radians [n]
+/// @param out Field values [n]
+/// @param n Number of points
+/// @param type Field type (FieldType)
+/// @param params Optional parameters of the field
+void evaluate( const double* lon, const double* lat, double* out, size_t n, int type,
+               const FieldParameters& params = FieldParameters() );
+
+/// @brief Get the field type from its name (e.g., "harmonic16", "williamson6")
+/// @return Field type, or -1 if the name is unknown
+int type_from_name( const std::string& name );
+
+/// @brief Name of a field type
+const char* name( int type );
+
+/// @brief Comma separated list of all the field names (for help messages)
+std::string all_names();
+}  // namespace FieldFunctions
+
+#endif  // #ifndef __FieldFunctions_hpp_
@@ -0,0 +1,55 @@
+// Example Includes
+#include "HaloCoroutines.hpp"
+
+#ifdef HALO_HAVE_COROUTINES
+
+bool ExchangeScheduler::Awaiter::await_suspend( ExchangeTask::Handle handle )
+{
+    const int channel = handle.promise().channel;
+    mResult           = mScheduler.mHalo.begin_exchange( mTags, channel );
+    if( mResult != moab::MB_SUCCESS ) return false;
+    mScheduler.mWaiting.push_back( { handle, this } );
+    return true;
+}
+
+void ExchangeScheduler::spawn( ExchangeTask&& task )
+{
+    // The channels are opened once and reused, so that their buffers persist across runs
+    if( mTasks.size() == mChannels.size() ) mChannels.push_back( mHalo.open_channel() );
+    task.mHandle.promise().channel = mChannels[mTasks.size()];
+    mTasks.push_back( std::move( task ) );
+}
+
+moab::ErrorCode ExchangeScheduler::run()
+{
+    // Every task runs until its first exchange is in flight (or until it completes)
+    for( auto& task : mTasks )
+        task.mHandle.resume();
+
+    // Resume the tasks in the order their messages arrive; a resumed task may start its next exchange
+    while( !mWaiting.empty() )
+    {
+        for( size_t iw = 0; iw < mWaiting.size(); )
+        {
+            const Waiter waiter = mWaiting[iw];
+            const int channel   = waiter.handle.promise().channel;
+            if( !mHalo.test_exchange( channel ) )
+            {
+                ++iw;
+                continue;
+            }
+            mWaiting[iw] = mWaiting.back();
+            mWaiting.pop_back();
+            waiter.awaiter->mResult = mHalo.end_exchange( channel );
+            waiter.handle.resume();
+        }
+    }
+
+    moab::ErrorCode rval = moab::MB_SUCCESS;
+    for( auto& task : mTasks )
+        if( rval == moab::MB_SUCCESS ) rval = task.mHandle.promise().result;
+    mTasks.clear();
+    return rval;
+}
+
+#endif  // #ifdef HALO_HAVE_COROUTINES
@@ -0,0 +1,150 @@
+#ifndef __HaloCoroutines_hpp_
+#define __HaloCoroutines_hpp_
+
+// Example Includes
+#include "HaloExchange.hpp"
+
+// The coroutine interface needs a C++20 compiler (CXX20FLAGS in the makefile); without it only the
+// split-phase interface of the HaloExchange is available
+#if defined( __has_include )
+#if __has_include( <coroutine> ) && defined( __cpp_impl_coroutine )
+#define HALO_HAVE_COROUTINES 1
+#endif
+#endif
+
+#ifdef HALO_HAVE_COROUTINES
+
+// C++ includes
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <vector>
+
+class ExchangeScheduler;
+
+/// @brief Coroutine running a sequence of halo exchanges (and the work between them) under an
+/// ExchangeScheduler. The coroutine is created suspended and only starts when the scheduler runs;
+/// its result is the error code given to co_return.
+class ExchangeTask
+{
+  public:
+    struct promise_type
+    {
+        int channel{ 0 };                            /// channel of the exchanges of the task
+        moab::ErrorCode result{ moab::MB_SUCCESS };  /// value given to co_return
+
+        ExchangeTask get_return_object()
+        {
+            return ExchangeTask( std::coroutine_handle< promise_type >::from_promise( *this ) );
+        }
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_value( moab::ErrorCode rval )
+        {
+            result = rval;
+        }
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+
+    using Handle = std::coroutine_handle< promise_type >;
+
+    ExchangeTask( ExchangeTask&& other ) noexcept : mHandle( std::exchange( other.mHandle, nullptr ) ) {}
+    ExchangeTask( const ExchangeTask& )            = delete;
+    ExchangeTask& operator=( const ExchangeTask& ) = delete;
+    ~ExchangeTask()
+    {
+        if( mHandle ) mHandle.destroy();
+    }
+
+  private:
+    friend class ExchangeScheduler;
+
+    explicit ExchangeTask( Handle handle ) : mHandle( handle ) {}
+
+    Handle mHandle;
+};
+
+/// @brief The ExchangeScheduler runs several ExchangeTask coroutines on one thread, each with its own
+/// channel of the HaloExchange, so that their exchanges are in flight at the same time. A task
+/// suspends on co_await scheduler.exchange( tags ) once the receives are posted and the messages sent;
+/// the scheduler then polls the requests of all the suspended tasks (MPI_Testall) and resumes each
+/// task as soon as its messages have arrived and are unpacked. Channels are assigned in spawn order
+/// and reused by later runs, so all the processes must spawn the same tasks in the same order.
+class ExchangeScheduler
+{
+  public:
+    /// @brief Awaitable split-phase exchange: started when the task suspends, completed when it resumes
+    class Awaiter
+    {
+      public:
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        /// @brief Start the exchange on the channel of the task (the task is resumed at once on failure)
+        bool await_suspend( ExchangeTask::Handle handle );
+
+        /// @brief Error code of the exchange
+        moab::ErrorCode await_resume() const noexcept
+        {
+            return mResult;
+        }
+
+      private:
+        friend class ExchangeScheduler;
+
+        Awaiter( ExchangeScheduler& scheduler, const std::vector< moab::Tag >& tags )
+            : mScheduler( scheduler ), mTags( tags )
+        {
+        }
+
+        ExchangeScheduler& mScheduler;
+        const std::vector< moab::Tag >& mTags;
+        moab::ErrorCode mResult{ moab::MB_SUCCESS };
+    };
+
+    /// @brief Constructor
+    /// @param halo Halo exchange engine (set up); the scheduler opens the channels it needs in it
+    explicit ExchangeScheduler( HaloExchange& halo ) : mHalo( halo ) {}
+
+    /// @brief Add a task to the next run; it gets the next channel of the scheduler
+    void spawn( ExchangeTask&& task );
+
+    /// @brief Exchange dense double tags from a task: co_await scheduler.exchange( tags ) returns the
+    ///        error code of the exchange. The tags must stay alive until the task resumes
+    Awaiter exchange( const std::vector< moab::Tag >& tags )
+    {
+        return Awaiter( *this, tags );
+    }
+
+    /// @brief Run all the spawned tasks until they have all completed, and release them
+    /// @return First error code returned by a task or an exchange (else MB_SUCCESS)
+    moab::ErrorCode run();
+
+  private:
+    /// @brief Task suspended on an exchange
+    struct Waiter
+    {
+        ExchangeTask::Handle handle;
+        Awaiter* awaiter;
+    };
+
+    HaloExchange& mHalo;
+    std::vector< int > mChannels;        /// channels opened by the scheduler, in spawn order
+    std::vector< ExchangeTask > mTasks;  /// tasks of the next run
+    std::vector< Waiter > mWaiting;      /// tasks with an exchange in flight
+};
+
+#endif  // #ifdef HALO_HAVE_COROUTINES
+
+#endif  // #ifndef __HaloCoroutines_hpp_
@@ -0,0 +1,1184 @@
+// Example Includes
+#include "HaloExchange.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// C++ includes
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+
+/// MPI message tag of the halo exchange messages of channel 0, channel c using HALO_MPI_TAG + c
+/// (distinct from the ParallelComm tags)
+static const int HALO_MPI_TAG = 1001;
+
+/// MPI message tag of the reverse (reduction) messages, below the tags of the channels
+static const int REDUCE_MPI_TAG = 1000;
+
+/// Slots of the send and receive buffers in the buffer pool
+static const size_t SEND_BUFFER = 0;
+static const size_t RECV_BUFFER = 1;
+
+/// Minimum average length (in entities) of the contiguous runs of a receive list to receive in place
+static const size_t MIN_RUN_LENGTH = 4;
+
+HaloExchange::HaloExchange( moab::Interface* mbImpl_, moab::ParallelComm* pcomm_ ) : mbImpl( mbImpl_ ), pcomm( pcomm_ )
+{
+    // Default channel of the blocking exchanges
+    mChannels.emplace_back();
+}
+
+int HaloExchange::open_channel()
+{
+    // Every channel has its own pair of buffers in the pool
+    const int channel = static_cast< int >( mChannels.size() );
+    mChannels.emplace_back();
+    mChannels.back().channel = channel;
+    mBuffers.add_slots( 2 );
+    return channel;
+}
+
+HaloExchange::~HaloExchange()
+{
+    stop_progress_thread();
+    free_types();
+    free_partitions();
+}
+
+bool HaloExchange::partitioned_available()
+{
+#if MPI_VERSION >= 4
+    return true;
+#else
+    return false;
+#endif
+}
+
+void HaloExchange::free_types()
+{
+    for( auto& entry : mTypes )
+    {
+        for( auto& type : entry.second.send )
+            if( type != MPI_DATATYPE_NULL ) MPI_Type_free( &type );
+        for( auto& type : entry.second.recv )
+            if( type != MPI_DATATYPE_NULL ) MPI_Type_free( &type );
+    }
+    mTypes.clear();
+}
+
+/// @brief Stable sort of a list of entities by ghost layer, and number of entities in layers 0..layer [layer]
+static void order_by_layer( std::vector< int >& ids, const std::vector< int >& layers, int numLayers,
+                            std::vector< size_t >& layerEnds )
+{
+    std::vector< size_t > order( ids.size() );
+    std::iota( order.begin(), order.end(), 0 );
+    std::stable_sort( order.begin(), order.end(), [&]( size_t a, size_t b ) { return layers[a] < layers[b]; } );
+    std::vector< int > sorted( ids.size() );
+    for( size_t ie = 0; ie < order.size(); ++ie )
+        sorted[ie] = ids[order[ie]];
+    ids.swap( sorted );
+
+    layerEnds.assign( numLayers + 1, 0 );
+    for( int layer : layers )
+        ++layerEnds[std::min( std::max( layer, 0 ), numLayers )];
+    std::partial_sum( layerEnds.begin(), layerEnds.end(), layerEnds.begin() );
+}
+
+moab::ErrorCode HaloExchange::setup( const moab::Range& entities, const std::vector< int >& layers )
+{
+    mEntities = entities;
+    mNeighbors.clear();
+    free_types();
+    free_partitions();
+    mChunkEntities = 0;
+    mBindings.clear();
+    mThreadNeighbors.clear();
+
+    // Collect (handle on the receiving side, local index) pairs per neighbor. The owner sorts
+    // its send list by the remote handle and the receiver sorts its receive list by the local
+    // handle, so that both sides agree on the message layout without exchanging any handles.
+    typedef std::vector< std::pair< moab::EntityHandle, int > > HandleList;
+    std::map< int, HandleList > sendLists, recvLists;
+
+    const int rank = pcomm->rank();
+    int sharingProcs[MAX_SHARING_PROCS];
+    moab::EntityHandle sharingHandles[MAX_SHARING_PROCS];
+    unsigned char pstatus;
+    int numSharing = 0;
+    int index      = 0;
+    for( auto it = mEntities.begin(); it != mEntities.end(); ++it, ++index )
+    {
+        moab::ErrorCode rval =
+            pcomm->get_sharing_data( *it, sharingProcs, sharingHandles, pstatus, numSharing );MB_CHK_ERR( rval );
+        if( !numSharing ) continue;  // interior entity
+
+        if( pstatus & PSTATUS_NOT_OWNED )
+        {
+            int owner                     = -1;
+            moab::EntityHandle ownerHandle = 0;
+            rval                          = pcomm->get_owner_handle( *it, owner, ownerHandle );MB_CHK_ERR( rval );
+            recvLists[owner].push_back( std::make_pair( *it, index ) );
+        }
+        else
+        {
+            for( int ip = 0; ip < numSharing; ++ip )
+                if( sharingProcs[ip] >= 0 && sharingProcs[ip] != rank )
+                    sendLists[sharingProcs[ip]].push_back( std::make_pair( sharingHandles[ip], index ) );
+        }
+    }
+
+    // The sharing relation is symmetric, so the neighbor list is the union of both maps
+    std::map< int, Neighbor > neighbors;
+    for( auto& entry : sendLists )
+    {
+        std::sort( entry.second.begin(), entry.second.end() );
+        Neighbor& nbr = neighbors[entry.first];
+        nbr.rank      = entry.first;
+        for( auto& item : entry.second )
+            nbr.send_ids.push_back( item.second );
+    }
+    for( auto& entry : recvLists )
+    {
+        std::sort( entry.second.begin(), entry.second.end() );
+        Neighbor& nbr = neighbors[entry.first];
+        nbr.rank      = entry.first;
+        for( auto& item : entry.second )
+            nbr.recv_ids.push_back( item.second );
+    }
+    for( auto& entry : neighbors )
+        mNeighbors.push_back( entry.second );
+
+    // Offsets of the messages of every neighbor in the send and receive buffers (in entities)
+    mSendOffsets.assign( 1, 0 );
+    mRecvOffsets.assign( 1, 0 );
+    for( auto& nbr : mNeighbors )
+    {
+        mSendOffsets.push_back( mSendOffsets.back() + nbr.send_ids.size() );
+        mRecvOffsets.push_back( mRecvOffsets.back() + nbr.recv_ids.size() );
+    }
+
+    // Handshake: verify that every neighbor sends exactly the number of entities we expect
+    const size_t numNeighbors = mNeighbors.size();
+    std::vector< int > sendCounts( numNeighbors ), remoteCounts( numNeighbors, -1 );
+    std::vector< MPI_Request > requests( 2 * numNeighbors );
+    for( size_t in = 0; in < numNeighbors; ++in )
+    {
+        sendCounts[in] = static_cast< int >( mNeighbors[in].send_ids.size() );
+        MPI_Irecv( &remoteCounts[in], 1, MPI_INT, mNeighbors[in].rank, HALO_MPI_TAG, pcomm->comm(),
+                   &requests[in] );
+        MPI_Isend( &sendCounts[in], 1, MPI_INT, mNeighbors[in].rank, HALO_MPI_TAG, pcomm->comm(),
+                   &requests[numNeighbors + in] );
+    }
+    MPI_Waitall( static_cast< int >( requests.size() ), requests.data(), MPI_STATUSES_IGNORE );
+
+    for( size_t in = 0; in < numNeighbors; ++in )
+        if( remoteCounts[in] != static_cast< int >( mNeighbors[in].recv_ids.size() ) )
+            MB_SET_ERR( moab::MB_FAILURE, "Inconsistent halo pattern with rank " << mNeighbors[in].rank << ": expected "
+                                                                                 << mNeighbors[in].recv_ids.size()
+                                                                                 << " entities, neighbor sends "
+                                                                                 << remoteCounts[in] );
+
+    // Ghost layers: every receiver sends the layers of its receive list to the owner, and both sides
+    // order their lists by that layer (keeping the handle order within a layer), so that the entities
+    // of the first layers form a prefix of every message
+    int localLayers = layers.empty() ? 0 : *std::max_element( layers.begin(), layers.end() );
+    MPI_Allreduce( &localLayers, &mNumLayers, 1, MPI_INT, MPI_MAX, pcomm->comm() );
+    if( mNumLayers > 0 )
+    {
+        if( layers.size() != mEntities.size() )
+            MB_SET_ERR( moab::MB_FAILURE, "The ghost layers must be given for all the entities on all the processes" );
+        std::vector< std::vector< int > > sendLayers( numNeighbors ), recvLayers( numNeighbors );
+        for( size_t in = 0; in < numNeighbors; ++in )
+        {
+            Neighbor& nbr = mNeighbors[in];
+            sendLayers[in].resize( nbr.send_ids.size() );
+            for( int id : nbr.recv_ids )
+                recvLayers[in].push_back( layers[id] );
+            MPI_Irecv( sendLayers[in].data(), static_cast< int >( sendLayers[in].size() ), MPI_INT, nbr.rank,
+                       HALO_MPI_TAG, pcomm->comm(), &requests[in] );
+            MPI_Isend( recvLayers[in].data(), static_cast< int >( recvLayers[in].size() ), MPI_INT, nbr.rank,
+                       HALO_MPI_TAG, pcomm->comm(), &requests[numNeighbors + in] );
+        }
+        MPI_Waitall( static_cast< int >( requests.size() ), requests.data(), MPI_STATUSES_IGNORE );
+        for( size_t in = 0; in < numNeighbors; ++in )
+        {
+            order_by_layer( mNeighbors[in].send_ids, sendLayers[in], mNumLayers, mNeighbors[in].send_layer_ends );
+            order_by_layer( mNeighbors[in].recv_ids, recvLayers[in], mNumLayers, mNeighbors[in].recv_layer_ends );
+        }
+    }
+
+    reset_timers();
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode HaloExchange::bind_tag( moab::Tag tag, TagBinding*& binding )
+{
+    auto found = mBindings.find( tag );
+    if( found != mBindings.end() )
+    {
+        binding = &found->second;
+        return moab::MB_SUCCESS;
+    }
+
+    moab::DataType dataType;
+    moab::ErrorCode rval = mbImpl->tag_get_data_type( tag, dataType );MB_CHK_ERR( rval );
+    if( dataType != moab::MB_TYPE_DOUBLE )
+        MB_SET_ERR( moab::MB_TYPE_OUT_OF_RANGE, "Only double tags can be exchanged" );
+
+    TagBinding newBinding;
+    rval = mbImpl->tag_get_length( tag, newBinding.ncomp );MB_CHK_ERR( rval );
+
+    // Resolve the location of every entity in dense tag storage, one contiguous chunk at a time
+    std::vector< double* > entityData( mEntities.size(), nullptr );
+    size_t index = 0;
+    for( auto it = mEntities.begin(); it != mEntities.end(); )
+    {
+        int count   = 0;
+        void* chunk = nullptr;
+        rval        = mbImpl->tag_iterate( tag, it, mEntities.end(), count, chunk );
+        MB_CHK_SET_ERR( rval, "Tag is not dense" );
+        double* values = static_cast< double* >( chunk );
+        for( int ie = 0; ie < count; ++ie )
+            entityData[index++] = values + ie * newBinding.ncomp;
+        it += count;
+    }
+
+    newBinding.send_ptrs.resize( mNeighbors.size() );
+    newBinding.recv_ptrs.resize( mNeighbors.size() );
+    for( size_t in = 0; in < mNeighbors.size(); ++in )
+    {
+        for( int id : mNeighbors[in].send_ids )
+            newBinding.send_ptrs[in].push_back( entityData[id] );
+        for( int id : mNeighbors[in].recv_ids )
+            newBinding.recv_ptrs[in].push_back( entityData[id] );
+    }
+
+    binding = &( mBindings[tag] = newBinding );
+    return moab::MB_SUCCESS;
+}
+
+const HaloExchange::TypeSet& HaloExchange::datatypes( const moab::Tag* tags, size_t ntags,
+                                                      const std::vector< TagBinding* >& active )
+{
+    std::vector< moab::Tag > key( tags, tags + ntags );
+    auto found = mTypes.find( key );
+    if( found != mTypes.end() ) return found->second;
+
+    // Any send list can be described with a datatype, but short receive runs are cheaper to unpack
+    TypeSet& types = mTypes[key];
+    types.send.resize( mNeighbors.size() );
+    types.recv.resize( mNeighbors.size() );
+    for( size_t in = 0; in < mNeighbors.size(); ++in )
+    {
+        types.send[in] = create_type( active, in, true, 1 );
+        types.recv[in] = create_type( active, in, false, MIN_RUN_LENGTH );
+    }
+    return types;
+}
+
+MPI_Datatype HaloExchange::create_type( const std::vector< TagBinding* >& active, size_t in, bool send,
+                                        size_t minRunLength ) const
+{
+    const size_t nents = send ? mNeighbors[in].send_ids.size() : mNeighbors[in].recv_ids.size();
+    if( !nents ) return MPI_DATATYPE_NULL;
+
+    // Blocks of contiguous entities in dense tag storage, in message order: tag by tag, and within a
+    // tag in the order of the send or receive list
+    std::vector< int > lengths;
+    std::vector< MPI_Aint > displacements;
+    for( auto binding : active )
+    {
+        const auto& ptrs = send ? binding->send_ptrs[in] : binding->recv_ptrs[in];
+        for( size_t first = 0, last = 0; first < nents; first = last )
+        {
+            last = first + 1;
+            while( last < nents && ptrs[last] == ptrs[last - 1] + binding->ncomp )
+                ++last;
+            MPI_Aint address;
+            MPI_Get_address( ptrs[first], &address );
+            displacements.push_back( address );
+            lengths.push_back( static_cast< int >( last - first ) * binding->ncomp );
+        }
+    }
+    if( nents * active.size() < minRunLength * lengths.size() ) return MPI_DATATYPE_NULL;
+
+    // Blocks of equal length (e.g., isolated entities of a single tag) map to the cheaper indexed-block type
+    MPI_Datatype type = MPI_DATATYPE_NULL;
+    if( std::all_of( lengths.begin(), lengths.end(), [&lengths]( int length ) { return length == lengths[0]; } ) )
+        MPI_Type_create_hindexed_block( static_cast< int >( lengths.size() ), lengths[0], displacements.data(),
+                                        MPI_DOUBLE, &type );
+    else
+        MPI_Type_create_hindexed( static_cast< int >( lengths.size() ), lengths.data(), displacements.data(),
+                                  MPI_DOUBLE, &type );
+    MPI_Type_commit( &type );
+    return type;
+}
+
+void HaloExchange::pack_entities( const Pass& pass, size_t in, size_t first, size_t last, double* buffer ) const
+{
+    // One section per tag, holding all the components of the entities
+    const size_t nents = last - first;
+    for( auto binding : pass.active )
+    {
+        const double* const* sendPtrs = binding->send_ptrs[in].data() + first;
+        const int tagComp             = binding->ncomp;
+        if( tagComp == 1 )
+        {
+            for( size_t ie = 0; ie < nents; ++ie )
+                buffer[ie] = *sendPtrs[ie];
+        }
+        else
+        {
+            for( size_t ie = 0; ie < nents; ++ie )
+                std::copy( sendPtrs[ie], sendPtrs[ie] + tagComp, buffer + ie * tagComp );
+        }
+        buffer += nents * tagComp;
+    }
+}
+
+void HaloExchange::unpack_entities( const Pass& pass, size_t in, size_t first, size_t last,
+                                    const double* buffer ) const
+{
+    // Scatter the received values into the shared and ghost copies
+    const size_t nents = last - first;
+    for( auto binding : pass.active )
+    {
+        double* const* recvPtrs = binding->recv_ptrs[in].data() + first;
+        const int tagComp       = binding->ncomp;
+        if( tagComp == 1 )
+        {
+            for( size_t ie = 0; ie < nents; ++ie )
+                *recvPtrs[ie] = buffer[ie];
+        }
+        else
+        {
+            for( size_t ie = 0; ie < nents; ++ie )
+                std::copy( buffer + ie * tagComp, buffer + ( ie + 1 ) * tagComp, recvPtrs[ie] );
+        }
+        buffer += nents * tagComp;
+    }
+}
+
+void HaloExchange::pack_copies( const Pass& pass, size_t in, double* buffer ) const
+{
+    // Same layout as the forward messages from the neighbor: one section per tag
+    const size_t nents = mNeighbors[in].recv_ids.size();
+    for( auto binding : pass.active )
+    {
+        const double* const* recvPtrs = binding->recv_ptrs[in].data();
+        const int tagComp             = binding->ncomp;
+        for( size_t ie = 0; ie < nents; ++ie )
+            std::copy( recvPtrs[ie], recvPtrs[ie] + tagComp, buffer + ie * tagComp );
+        buffer += nents * tagComp;
+    }
+}
+
+/// @brief Combine a section of contributions into the owned values of the entities
+template < typename Combine >
+static void combine_section( double* const* ownedPtrs, size_t nents, int ncomp, const double* values,
+                             Combine combine )
+{
+    for( size_t ie = 0; ie < nents; ++ie )
+        for( int ic = 0; ic < ncomp; ++ic )
+            ownedPtrs[ie][ic] = combine( ownedPtrs[ie][ic], values[ie * ncomp + ic] );
+}
+
+void HaloExchange::combine_entities( const Pass& pass, size_t in, const double* buffer, ReduceOp op,
+                                     ReduceFunction function ) const
+{
+    // The contributions arrive in the order of the send list of the neighbor
+    const size_t nents = mNeighbors[in].send_ids.size();
+    for( auto binding : pass.active )
+    {
+        double* const* ownedPtrs = binding->send_ptrs[in].data();
+        const int tagComp        = binding->ncomp;
+        switch( op )
+        {
+            case REDUCE_SUM:
+                combine_section( ownedPtrs, nents, tagComp, buffer, []( double a, double b ) { return a + b; } );
+                break;
+            case REDUCE_MIN:
+                combine_section( ownedPtrs, nents, tagComp, buffer,
+                                 []( double a, double b ) { return std::min( a, b ); } );
+                break;
+            case REDUCE_MAX:
+                combine_section( ownedPtrs, nents, tagComp, buffer,
+                                 []( double a, double b ) { return std::max( a, b ); } );
+                break;
+            case REDUCE_CUSTOM:
+                combine_section( ownedPtrs, nents, tagComp, buffer, function );
+                break;
+        }
+        buffer += nents * tagComp;
+    }
+}
+
+void HaloExchange::post_receive( const Pass& pass, size_t in, MPI_Request* request )
+{
+    const int nvalues = static_cast< int >( recv_count( pass, in ) ) * pass.ncomp;
+    if( !nvalues ) return;
+    if( in_place( pass, in ) )
+        MPI_Irecv( MPI_BOTTOM, 1, pass.types->recv[in], mNeighbors[in].rank, HALO_MPI_TAG + pass.channel,
+                   pcomm->comm(), request );
+    else
+        MPI_Irecv( pass.recvBuffer + mRecvOffsets[in] * pass.ncomp, nvalues, MPI_DOUBLE, mNeighbors[in].rank,
+                   HALO_MPI_TAG + pass.channel, pcomm->comm(), request );
+}
+
+void HaloExchange::pack_and_send( const Pass& pass, size_t in, MPI_Request* request )
+{
+    const size_t nsend = send_count( pass, in );
+    if( !nsend ) return;
+    const long long nbytes = nsend * pass.ncomp * sizeof( double );
+    const double tTrace    = mTrace ? MPI_Wtime() : 0.0;
+    if( pass.sendTyped )
+    {
+        // MPI gathers the owned boundary values directly from tag storage
+        MPI_Isend( MPI_BOTTOM, 1, pass.types->send[in], mNeighbors[in].rank, HALO_MPI_TAG + pass.channel,
+                   pcomm->comm(), request );
+        trace( TraceRecorder::SEND, tTrace, MPI_Wtime(), mNeighbors[in].rank, nbytes );
+        return;
+    }
+
+    double* const message = pass.sendBuffer + mSendOffsets[in] * pass.ncomp;
+    pack_entities( pass, in, 0, nsend, message );
+    const double tCopied = mTrace ? MPI_Wtime() : 0.0;
+    MPI_Isend( message, static_cast< int >( nsend ) * pass.ncomp, MPI_DOUBLE, mNeighbors[in].rank,
+               HALO_MPI_TAG + pass.channel, pcomm->comm(), request );
+    trace( TraceRecorder::PACK, tTrace, tCopied, mNeighbors[in].rank, nbytes );
+    trace( TraceRecorder::SEND, tCopied, mTrace ? MPI_Wtime() : 0.0, mNeighbors[in].rank, nbytes );
+}
+
+void HaloExchange::unpack( const Pass& pass, size_t in )
+{
+    const size_t nrecv = recv_count( pass, in );
+    if( !nrecv || in_place( pass, in ) ) return;
+    const double tTrace = mTrace ? MPI_Wtime() : 0.0;
+    unpack_entities( pass, in, 0, nrecv, pass.recvBuffer + mRecvOffsets[in] * pass.ncomp );
+    trace( TraceRecorder::UNPACK, tTrace, mTrace ? MPI_Wtime() : 0.0, mNeighbors[in].rank,
+           static_cast< long long >( nrecv * pass.ncomp * sizeof( double ) ) );
+}
+
+void HaloExchange::trace( TraceRecorder::Phase phase, double begin, double end, int neighbor, long long bytes )
+{
+    if( !mTrace ) return;
+    // the recorder is shared by all the threads of a threaded exchange
+#pragma omp critical( halo_trace )
+    mTrace->record( phase, begin, end, neighbor, bytes );
+}
+
+moab::ErrorCode HaloExchange::bind_tags( const moab::Tag* tags, size_t ntags, Pass& pass )
+{
+    // Start from a clean state of the channel, keeping the capacity of its lists
+    Pass fresh;
+    fresh.channel = pass.channel;
+    fresh.active.swap( pass.active );
+    fresh.requests.swap( pass.requests );
+    pass = std::move( fresh );
+
+    // Number of values per entity in every message, summed over all the tags
+    pass.active.resize( ntags );
+    for( size_t it = 0; it < ntags; ++it )
+    {
+        moab::ErrorCode rval = bind_tag( tags[it], pass.active[it] );MB_CHK_ERR( rval );
+        pass.ncomp += pass.active[it]->ncomp;
+    }
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode HaloExchange::prepare( const moab::Tag* tags, size_t ntags, bool splitPhase, int depth,
+                                      Pass& pass )
+{
+    moab::ErrorCode rval = bind_tags( tags, ntags, pass );MB_CHK_ERR( rval );
+    pass.depth = ( depth > 0 && depth < mNumLayers ) ? depth : 0;
+
+    // Split-phase exchanges send monolithic messages, partitioned messages need MPI-4, and the
+    // datatypes describe the complete messages
+    pass.strategy = mPackStrategy;
+    if( ( splitPhase && pass.strategy != PACK_DATATYPE ) ||
+        ( pass.strategy == PACK_PARTITIONED && !partitioned_available() ) || pass.depth )
+        pass.strategy = PACK_BUFFER;
+    const bool monolithic = ( pass.strategy == PACK_BUFFER || pass.strategy == PACK_DATATYPE );
+    pass.sendTyped        = ( pass.strategy == PACK_DATATYPE );
+    pass.inPlace          = mReceiveInPlace && monolithic && !pass.depth;
+    pass.types            = ( pass.sendTyped || pass.inPlace ) ? &datatypes( tags, ntags, pass.active ) : nullptr;
+    for( size_t in = 0; in < mNeighbors.size(); ++in )
+    {
+        const size_t nbytes = recv_count( pass, in ) * pass.ncomp * sizeof( double );
+        mReceivedBytes += nbytes;
+        if( in_place( pass, in ) ) mInPlaceBytes += nbytes;
+    }
+    if( !monolithic ) return moab::MB_SUCCESS;
+
+    const size_t slot = 2 * pass.channel;
+    pass.sendBuffer =
+        pass.sendTyped ? nullptr : mBuffers.acquire( slot + SEND_BUFFER, num_send_entities() * pass.ncomp );
+    pass.recvBuffer = mBuffers.acquire( slot + RECV_BUFFER, num_recv_entities() * pass.ncomp );
+    // Receives are posted in slot [in] and sends in slot [nneighbors + in] of the request list
+    pass.requests.assign( 2 * mNeighbors.size(), MPI_REQUEST_NULL );
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode HaloExchange::exchange_tags( const moab::Tag* tags, size_t ntags, int depth )
+{
+    Pass& pass = mChannels.front();
+    if( pass.pending ) MB_SET_ERR( moab::MB_FAILURE, "A split-phase exchange is still in progress" );
+    moab::ErrorCode rval = prepare( tags, ntags, false, depth, pass );MB_CHK_ERR( rval );
+    if( pass.strategy == PACK_PARTITIONED ) return exchange_partitioned( pass );
+    if( pass.strategy == PACK_PIPELINED ) return exchange_pipelined( pass );
+    if( mThreaded ) return exchange_threaded( pass );
+
+    start( pass );
+    finish( pass );
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode HaloExchange::reduce_tags( const moab::Tag* tags, size_t ntags, ReduceOp op,
+                                          ReduceFunction function )
+{
+    if( op == REDUCE_CUSTOM && !function ) MB_SET_ERR( moab::MB_FAILURE, "A custom reduction needs a function" );
+    Pass& pass = mChannels.front();
+    if( pass.pending ) MB_SET_ERR( moab::MB_FAILURE, "A split-phase exchange is still in progress" );
+    moab::ErrorCode rval = bind_tags( tags, ntags, pass );MB_CHK_ERR( rval );
+
+    // The messages run against the forward exchange: the copies are packed into the receive buffer,
+    // and the owners receive the contributions into the send buffer
+    const size_t numNeighbors = mNeighbors.size();
+    pass.sendBuffer           = mBuffers.acquire( RECV_BUFFER, num_recv_entities() * pass.ncomp );
+    pass.recvBuffer           = mBuffers.acquire( SEND_BUFFER, num_send_entities() * pass.ncomp );
+    pass.requests.assign( 2 * numNeighbors, MPI_REQUEST_NULL );
+
+    pass.tStart = MPI_Wtime();
+    for( size_t in = 0; in < numNeighbors; ++in )
+    {
+        const int nvalues = static_cast< int >( mNeighbors[in].send_ids.size() ) * pass.ncomp;
+        if( nvalues )
+            MPI_Irecv( pass.recvBuffer + mSendOffsets[in] * pass.ncomp, nvalues, MPI_DOUBLE, mNeighbors[in].rank,
+                       REDUCE_MPI_TAG, pcomm->comm(), &pass.requests[in] );
+    }
+    if( mPackCounters ) mPackCounters->start();
+    for( size_t in = 0; in < numNeighbors; ++in )
+    {
+        const size_t ncopies = mNeighbors[in].recv_ids.size();
+        if( !ncopies ) continue;
+        const long long nbytes = ncopies * pass.ncomp * sizeof( double );
+        const double tTrace    = mTrace ? MPI_Wtime() : 0.0;
+        double* const message  = pass.sendBuffer + mRecvOffsets[in] * pass.ncomp;
+        pack_copies( pass, in, message );
+        const double tCopied = mTrace ? MPI_Wtime() : 0.0;
+        MPI_Isend( message, static_cast< int >( ncopies ) * pass.ncomp, MPI_DOUBLE, mNeighbors[in].rank,
+                   REDUCE_MPI_TAG, pcomm->comm(), &pass.requests[numNeighbors + in] );
+        trace( TraceRecorder::PACK, tTrace, tCopied, mNeighbors[in].rank, nbytes );
+        trace( TraceRecorder::SEND, tCopied, mTrace ? MPI_Wtime() : 0.0, mNeighbors[in].rank, nbytes );
+    }
+    if( mPackCounters ) mPackCounters->stop();
+    pass.tPacked = MPI_Wtime();
+
+    // Combine the contributions in neighbor order while the later messages are still arriving
+    double waitTime = 0.0, combineTime = 0.0;
+    for( size_t in = 0; in < numNeighbors; ++in )
+    {
+        const double tWait = MPI_Wtime();
+        MPI_Wait( &pass.requests[in], MPI_STATUS_IGNORE );
+        const double tReceived = MPI_Wtime();
+        combine_entities( pass, in, pass.recvBuffer + mSendOffsets[in] * pass.ncomp, op, function );
+        const double tCombined = MPI_Wtime();
+        trace( TraceRecorder::WAIT, tWait, tReceived, mNeighbors[in].rank );
+        trace( TraceRecorder::UNPACK, tReceived, tCombined, mNeighbors[in].rank,
+               static_cast< long long >( mNeighbors[in].send_ids.size() * pass.ncomp * sizeof( double ) ) );
+        waitTime += tReceived - tWait;
+        combineTime += tCombined - tReceived;
+    }
+    const double tWait = MPI_Wtime();
+    MPI_Waitall( static_cast< int >( numNeighbors ), pass.requests.data() + numNeighbors, MPI_STATUSES_IGNORE );
+    waitTime += MPI_Wtime() - tWait;
+
+    mPhaseTimes.pack += pass.tPacked - pass.tStart;
+    mPhaseTimes.wait += waitTime;
+    mPhaseTimes.unpack += combineTime;
+    mCallTimes.push_back( pass.tPacked - pass.tStart + waitTime + combineTime );
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode HaloExchange::begin_exchange( const std::vector< moab::Tag >& tags, int channel )
+{
+    if( channel < 0 || channel >= static_cast< int >( mChannels.size() ) )
+        MB_SET_ERR( moab::MB_INDEX_OUT_OF_RANGE, "Invalid exchange channel " << channel );
+    Pass& pass = mChannels[channel];
+    if( pass.pending )
+        MB_SET_ERR( moab::MB_FAILURE, "A split-phase exchange is already in progress on channel " << channel );
+    moab::ErrorCode rval = prepare( tags.data(), tags.size(), true, 0, pass );MB_CHK_ERR( rval );
+    start( pass );
+    pass.pending = true;
+    // From now on only the progress thread calls MPI on the requests, until they are all complete
+    if( channel == 0 && mProgressThread.joinable() )
+    {
+        std::lock_guard< std::mutex > lock( mProgressMutex );
+        mInFlight.store( true, std::memory_order_release );
+        mProgressChanged.notify_all();
+    }
+    return moab::MB_SUCCESS;
+}
+
+bool HaloExchange::test_exchange( int channel )
+{
+    // An invalid channel has nothing in progress; end_exchange reports the error
+    if( channel < 0 || channel >= static_cast< int >( mChannels.size() ) ) return true;
+    Pass& pass = mChannels[channel];
+    if( !pass.pending ) return true;
+    if( channel == 0 && mInFlight.load( std::memory_order_acquire ) ) return false;
+    int done = 0;
+    MPI_Testall( static_cast< int >( pass.requests.size() ), pass.requests.data(), &done, MPI_STATUSES_IGNORE );
+    return done != 0;
+}
+
+moab::ErrorCode HaloExchange::end_exchange( int channel )
+{
+    if( channel < 0 || channel >= static_cast< int >( mChannels.size() ) || !mChannels[channel].pending )
+        MB_SET_ERR( moab::MB_FAILURE, "No split-phase exchange in progress on channel " << channel );
+    finish( mChannels[channel] );
+    mChannels[channel].pending = false;
+    return moab::MB_SUCCESS;
+}
+
+void HaloExchange::start( Pass& pass )
+{
+    // Post all receives first (directly into tag storage when possible), then pack and send the
+    // data for each neighbor
+    const size_t numNeighbors = mNeighbors.size();
+    pass.tStart               = MPI_Wtime();
+    for( size_t in = 0; in < numNeighbors; ++in )
+        post_receive( pass, in, &pass.requests[in] );
+
+    if( mPackCounters ) mPackCounters->start();
+    for( size_t in = 0; in < numNeighbors; ++in )
+        pack_and_send( pass, in, &pass.requests[numNeighbors + in] );
+    if( mPackCounters ) mPackCounters->stop();
+    pass.tPacked = MPI_Wtime();
+}
+
+void HaloExchange::finish( Pass& pass )
+{
+    // The wait phase starts when the caller needs the data (after its own work in a split-phase exchange)
+    // The progress thread only drives channel 0
+    const double tWait = MPI_Wtime();
+    if( &pass == &mChannels.front() )
+    {
+        std::unique_lock< std::mutex > lock( mProgressMutex );
+        mProgressChanged.wait( lock, [this]() { return !mInFlight.load( std::memory_order_acquire ); } );
+    }
+    MPI_Waitall( static_cast< int >( pass.requests.size() ), pass.requests.data(), MPI_STATUSES_IGNORE );
+    const double tReceived = MPI_Wtime();
+    trace( TraceRecorder::WAIT, tWait, tReceived );
+
+    for( size_t in = 0; in < mNeighbors.size(); ++in )
+        unpack( pass, in );
+    const double tEnd = MPI_Wtime();
+
+    mPhaseTimes.pack += pass.tPacked - pass.tStart;
+    mPhaseTimes.wait += tReceived - tWait;
+    mPhaseTimes.unpack += tEnd - tReceived;
+    mCallTimes.push_back( pass.tPacked - pass.tStart + tEnd - tWait );
+}
+
+/// @brief CPUs the calling thread may run on (empty if unknown)
+static std::vector< int > allowed_cpus()
+{
+    std::vector< int > cpus;
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO( &mask );
+    if( pthread_getaffinity_np( pthread_self(), sizeof( mask ), &mask ) == 0 )
+        for( int ic = 0; ic < CPU_SETSIZE; ++ic )
+            if( CPU_ISSET( ic, &mask ) ) cpus.push_back( ic );
+#endif
+    return cpus;
+}
+
+/// @brief Restrict the calling thread to a set of CPUs
+static void set_allowed_cpus( const std::vector< int >& cpus )
+{
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO( &mask );
+    for( int cpu : cpus )
+        CPU_SET( cpu, &mask );
+    pthread_setaffinity_np( pthread_self(), sizeof( mask ), &mask );
+#else
+    (void)cpus;
+#endif
+}
+
+/// @brief Pin a thread to a CPU
+/// @return The CPU the thread is pinned to, or -1 if it could not be pinned
+static int pin_thread( std::thread& thread, int cpu )
+{
+#ifdef __linux__
+    if( cpu < 0 || cpu >= CPU_SETSIZE ) return -1;
+    cpu_set_t mask;
+    CPU_ZERO( &mask );
+    CPU_SET( cpu, &mask );
+    return pthread_setaffinity_np( thread.native_handle(), sizeof( mask ), &mask ) == 0 ? cpu : -1;
+#else
+    (void)thread;
+    (void)cpu;
+    return -1;
+#endif
+}
+
+bool HaloExchange::start_progress_thread( int cpu, int& pinnedCpu )
+{
+    // The progress thread calls MPI concurrently with the application threads
+    int threadSupport = MPI_THREAD_SINGLE;
+    MPI_Query_thread( &threadSupport );
+    if( threadSupport < MPI_THREAD_MULTIPLE ) return false;
+
+    stop_progress_thread();
+
+    // The progress thread must not share a CPU with the compute of the caller: its CPU (by default
+    // the last one allowed for the caller) is taken away from the caller until the thread stops, and
+    // no thread is started if the caller may only run on that CPU
+    const std::vector< int > callerCpus = allowed_cpus();
+    if( cpu < 0 && !callerCpus.empty() ) cpu = callerCpus.back();
+    std::vector< int > computeCpus;
+    for( int ic : callerCpus )
+        if( ic != cpu ) computeCpus.push_back( ic );
+    pinnedCpu = -1;
+    if( !callerCpus.empty() && computeCpus.empty() ) return false;
+    if( computeCpus.size() != callerCpus.size() )
+    {
+        set_allowed_cpus( computeCpus );
+        mCallerCpus = callerCpus;
+    }
+
+    mProgressRunning.store( true, std::memory_order_release );
+    mProgressThread = std::thread( [this]() {
+        // Sleep until an exchange is in flight on the default channel, then test its requests until
+        // they are all complete
+        std::vector< MPI_Request >& requests = mChannels.front().requests;
+        while( true )
+        {
+            {
+                std::unique_lock< std::mutex > lock( mProgressMutex );
+                mProgressChanged.wait( lock, [this]() {
+                    return !mProgressRunning.load( std::memory_order_acquire ) ||
+                           mInFlight.load( std::memory_order_acquire );
+                } );
+                if( !mProgressRunning.load( std::memory_order_acquire ) ) return;
+            }
+            int done = 0;
+            MPI_Testall( static_cast< int >( requests.size() ), requests.data(), &done, MPI_STATUSES_IGNORE );
+            if( done )
+            {
+                std::lock_guard< std::mutex > lock( mProgressMutex );
+                mInFlight.store( false, std::memory_order_release );
+                mProgressChanged.notify_all();
+            }
+        }
+    } );
+    pinnedCpu = pin_thread( mProgressThread, cpu );
+    return true;
+}
+
+void HaloExchange::stop_progress_thread()
+{
+    if( !mProgressThread.joinable() ) return;
+    // An exchange in flight is completed by end_exchange
+    {
+        std::lock_guard< std::mutex > lock( mProgressMutex );
+        mInFlight.store( false, std::memory_order_release );
+        mProgressRunning.store( false, std::memory_order_release );
+        mProgressChanged.notify_all();
+    }
+    mProgressThread.join();
+    if( !mCallerCpus.empty() ) set_allowed_cpus( mCallerCpus );
+    mCallerCpus.clear();
+}
+
+moab::ErrorCode HaloExchange::exchange_threaded( Pass& pass )
+{
+#ifdef _OPENMP
+    // Balance the neighbors over the threads by message size (largest first, onto the least loaded thread)
+    const int nthreads = omp_get_max_threads();
+    if( static_cast< int >( mThreadNeighbors.size() ) != nthreads )
+    {
+        std::vector< size_t > order( mNeighbors.size() );
+        std::iota( order.begin(), order.end(), size_t( 0 ) );
+        auto load = [this]( size_t in ) { return mNeighbors[in].send_ids.size() + mNeighbors[in].recv_ids.size(); };
+        std::stable_sort( order.begin(), order.end(), [&load]( size_t a, size_t b ) { return load( a ) > load( b ); } );
+        mThreadNeighbors.assign( nthreads, std::vector< size_t >() );
+        std::vector< size_t > threadLoad( nthreads, 0 );
+        for( size_t in : order )
+        {
+            const int ithread = static_cast< int >( std::min_element( threadLoad.begin(), threadLoad.end() ) -
+                                                    threadLoad.begin() );
+            mThreadNeighbors[ithread].push_back( in );
+            threadLoad[ithread] += load( in );
+        }
+    }
+
+    const size_t numNeighbors = mNeighbors.size();
+    const double tStart       = MPI_Wtime();
+    PhaseTimes slowest;
+#pragma omp parallel num_threads( nthreads )
+    {
+        // Every thread drives the complete exchange of its own neighbors (MPI_THREAD_MULTIPLE)
+        const int team = omp_get_num_threads();
+        std::vector< size_t > mine;
+        for( int list = omp_get_thread_num(); list < nthreads; list += team )
+            mine.insert( mine.end(), mThreadNeighbors[list].begin(), mThreadNeighbors[list].end() );
+
+        PhaseTimes times;
+        double tPhase = MPI_Wtime();
+        for( size_t in : mine )
+            post_receive( pass, in, &pass.requests[in] );
+        for( size_t in : mine )
+            pack_and_send( pass, in, &pass.requests[numNeighbors + in] );
+        times.pack = MPI_Wtime() - tPhase;
+
+        // Unpack every message as soon as it has arrived
+        for( size_t in : mine )
+        {
+            tPhase = MPI_Wtime();
+            MPI_Wait( &pass.requests[in], MPI_STATUS_IGNORE );
+            const double tReceived = MPI_Wtime();
+            times.wait += tReceived - tPhase;
+            trace( TraceRecorder::WAIT, tPhase, tReceived, mNeighbors[in].rank );
+            unpack( pass, in );
+            times.unpack += MPI_Wtime() - tReceived;
+        }
+        tPhase = MPI_Wtime();
+        for( size_t in : mine )
+            MPI_Wait( &pass.requests[numNeighbors + in], MPI_STATUS_IGNORE );
+        times.wait += MPI_Wtime() - tPhase;
+
+#pragma omp critical( halo_times )
+        {
+            slowest.pack   = std::max( slowest.pack, times.pack );
+            slowest.wait   = std::max( slowest.wait, times.wait );
+            slowest.unpack = std::max( slowest.unpack, times.unpack );
+        }
+    }
+    const double tEnd = MPI_Wtime();
+
+    mPhaseTimes.pack += slowest.pack;
+    mPhaseTimes.wait += slowest.wait;
+    mPhaseTimes.unpack += slowest.unpack;
+    mCallTimes.push_back( tEnd - tStart );
+    return moab::MB_SUCCESS;
+#else
+    (void)pass;
+    MB_SET_ERR( moab::MB_NOT_IMPLEMENTED, "Threaded halo exchanges require OpenMP" );
+#endif
+}
+
+/// @brief Number of partitions of a message of nents entities
+static inline size_t num_partitions( size_t nents, size_t partitionEntities )
+{
+    return ( nents + partitionEntities - 1 ) / partitionEntities;
+}
+
+void HaloExchange::create_partitions( int ncomp, size_t entities, double* send, double* recv )
+{
+    free_partitions();
+    PartitionSet& parts = mPartitions;
+    parts.ncomp         = ncomp;
+    parts.entities      = entities;
+    parts.send          = send;
+    parts.recv          = recv;
+
+    // The last partition of every message is padded, so that all the partitions have the same size
+    const size_t numNeighbors = mNeighbors.size();
+    parts.send_offsets.assign( 1, 0 );
+    parts.recv_offsets.assign( 1, 0 );
+    for( auto& nbr : mNeighbors )
+    {
+        parts.send_offsets.push_back( parts.send_offsets.back() +
+                                      num_partitions( nbr.send_ids.size(), entities ) * entities );
+        parts.recv_offsets.push_back( parts.recv_offsets.back() +
+                                      num_partitions( nbr.recv_ids.size(), entities ) * entities );
+    }
+    parts.send_request.assign( numNeighbors, -1 );
+    parts.recv_request.assign( numNeighbors, -1 );
+#if MPI_VERSION >= 4
+    const MPI_Count count = static_cast< MPI_Count >( entities ) * ncomp;
+    for( size_t in = 0; in < numNeighbors; ++in )
+    {
+        const int npart = static_cast< int >( num_partitions( mNeighbors[in].recv_ids.size(), entities ) );
+        if( !npart ) continue;
+        parts.recv_request[in] = static_cast< int >( parts.requests.size() );
+        parts.requests.push_back( MPI_REQUEST_NULL );
+        MPI_Precv_init( recv + parts.recv_offsets[in] * ncomp, npart, count, MPI_DOUBLE, mNeighbors[in].rank,
+                        HALO_MPI_TAG, pcomm->comm(), MPI_INFO_NULL, &parts.requests.back() );
+        for( int part = 0; part < npart; ++part )
+            parts.recv_parts.push_back( std::make_pair( in, part ) );
+    }
+    for( size_t in = 0; in < numNeighbors; ++in )
+    {
+        const int npart = static_cast< int >( num_partitions( mNeighbors[in].send_ids.size(), entities ) );
+        if( !npart ) continue;
+        parts.send_request[in] = static_cast< int >( parts.requests.size() );
+        parts.requests.push_back( MPI_REQUEST_NULL );
+        MPI_Psend_init( send + parts.send_offsets[in] * ncomp, npart, count, MPI_DOUBLE, mNeighbors[in].rank,
+                        HALO_MPI_TAG, pcomm->comm(), MPI_INFO_NULL, &parts.requests.back() );
+        for( int part = 0; part < npart; ++part )
+            parts.send_parts.push_back( std::make_pair( in, part ) );
+    }
+#endif
+}
+
+void HaloExchange::free_partitions()
+{
+    for( auto& request : mPartitions.requests )
+        if( request != MPI_REQUEST_NULL ) MPI_Request_free( &request );
+    mPartitions = PartitionSet();
+}
+
+moab::ErrorCode HaloExchange::exchange_partitioned( Pass& pass )
+{
+#if MPI_VERSION >= 4
+    // Partitions of whole entities of about the requested size
+    const size_t entities = std::max( mPartitionBytes / ( pass.ncomp * sizeof( double ) ), size_t( 1 ) );
+    size_t nsend = 0, nrecv = 0;
+    for( auto& nbr : mNeighbors )
+    {
+        nsend += num_partitions( nbr.send_ids.size(), entities ) * entities;
+        nrecv += num_partitions( nbr.recv_ids.size(), entities ) * entities;
+    }
+    pass.sendBuffer     = mBuffers.acquire( SEND_BUFFER, nsend * pass.ncomp );
+    pass.recvBuffer     = mBuffers.acquire( RECV_BUFFER, nrecv * pass.ncomp );
+    PartitionSet& parts = mPartitions;
+    if( parts.ncomp != pass.ncomp || parts.entities != entities || parts.send != pass.sendBuffer ||
+        parts.recv != pass.recvBuffer )
+        create_partitions( pass.ncomp, entities, pass.sendBuffer, pass.recvBuffer );
+
+    // The partitions are packed and unpacked by all the threads only if they are all allowed to call MPI
+    int threadSupport = MPI_THREAD_SINGLE;
+    MPI_Query_thread( &threadSupport );
+    const bool threaded = ( threadSupport == MPI_THREAD_MULTIPLE );
+    int nthreads        = 1;
+#ifdef _OPENMP
+    if( threaded ) nthreads = omp_get_max_threads();
+#endif
+
+    const double tStart = MPI_Wtime();
+    MPI_Startall( static_cast< int >( parts.requests.size() ), parts.requests.data() );
+
+    // Every partition is transferred as soon as it is packed, while the next ones are being packed
+    const int nsendParts = static_cast< int >( parts.send_parts.size() );
+#pragma omp parallel for schedule( dynamic ) if( threaded )
+    for( int ip = 0; ip < nsendParts; ++ip )
+    {
+        const size_t in    = parts.send_parts[ip].first;
+        const int part     = parts.send_parts[ip].second;
+        const size_t first = part * entities;
+        const size_t last  = std::min( first + entities, mNeighbors[in].send_ids.size() );
+        pack_entities( pass, in, first, last, parts.send + ( parts.send_offsets[in] + first ) * pass.ncomp );
+        MPI_Pready( part, parts.requests[parts.send_request[in]] );
+    }
+    const double tPacked = MPI_Wtime();
+    trace( TraceRecorder::PACK, tStart, tPacked );
+
+    // Every partition is unpacked as soon as it has arrived
+    const int nrecvParts = static_cast< int >( parts.recv_parts.size() );
+    double unpackTime    = 0.0;
+#pragma omp parallel for schedule( dynamic ) if( threaded ) reduction( + : unpackTime )
+    for( int ip = 0; ip < nrecvParts; ++ip )
+    {
+        const size_t in    = parts.recv_parts[ip].first;
+        const int part     = parts.recv_parts[ip].second;
+        const size_t first = part * entities;
+        const size_t last  = std::min( first + entities, mNeighbors[in].recv_ids.size() );
+        int arrived        = 0;
+        while( !arrived )
+            MPI_Parrived( parts.requests[parts.recv_request[in]], part, &arrived );
+        const double tArrived = MPI_Wtime();
+        unpack_entities( pass, in, first, last, parts.recv + ( parts.recv_offsets[in] + first ) * pass.ncomp );
+        unpackTime += MPI_Wtime() - tArrived;
+    }
+    MPI_Waitall( static_cast< int >( parts.requests.size() ), parts.requests.data(), MPI_STATUSES_IGNORE );
+    const double tEnd = MPI_Wtime();
+    trace( TraceRecorder::WAIT, tPacked, tEnd );
+
+    // Waiting and unpacking overlap: the unpack time is the average unpack time per thread
+    mPhaseTimes.pack += tPacked - tStart;
+    mPhaseTimes.unpack += unpackTime / nthreads;
+    mPhaseTimes.wait += std::max( tEnd - tPacked - unpackTime / nthreads, 0.0 );
+    mCallTimes.push_back( tEnd - tStart );
+    return moab::MB_SUCCESS;
+#else
+    (void)pass;
+    MB_SET_ERR( moab::MB_NOT_IMPLEMENTED, "Partitioned halo exchanges require MPI-4" );
+#endif
+}
+
+void HaloExchange::create_chunks( size_t entities )
+{
+    // Chunks are sent round-robin over the neighbors, so that every neighbor can start receiving early
+    mChunkEntities = entities;
+    mSendChunks.clear();
+    mRecvChunks.clear();
+    for( size_t first = 0, more = 1; more; first += entities )
+    {
+        more = 0;
+        for( size_t in = 0; in < mNeighbors.size(); ++in )
+        {
+            const size_t nsend = mNeighbors[in].send_ids.size(), nrecv = mNeighbors[in].recv_ids.size();
+            if( first < nsend ) mSendChunks.push_back( { in, first, std::min( first + entities, nsend ) } );
+            if( first < nrecv ) mRecvChunks.push_back( { in, first, std::min( first + entities, nrecv ) } );
+            more |= ( first + entities < std::max( nsend, nrecv ) );
+        }
+    }
+    mCompleted.resize( mRecvChunks.size() );
+}
+
+moab::ErrorCode HaloExchange::exchange_pipelined( Pass& pass )
+{
+    // Chunks of whole entities of about the requested size, each sent as its own message; MPI keeps the
+    // messages between two ranks in order, so the chunks of a neighbor match their receives one to one
+    const size_t entities = std::max( mChunkBytes / ( pass.ncomp * sizeof( double ) ), size_t( 1 ) );
+    if( entities != mChunkEntities ) create_chunks( entities );
+    pass.sendBuffer = mBuffers.acquire( SEND_BUFFER, num_send_entities() * pass.ncomp );
+    pass.recvBuffer = mBuffers.acquire( RECV_BUFFER, num_recv_entities() * pass.ncomp );
+
+    const int nrecvChunks = static_cast< int >( mRecvChunks.size() );
+    pass.requests.assign( mRecvChunks.size() + mSendChunks.size(), MPI_REQUEST_NULL );
+
+    const double tStart = MPI_Wtime();
+    for( int ic = 0; ic < nrecvChunks; ++ic )
+    {
+        const Chunk& chunk = mRecvChunks[ic];
+        MPI_Irecv( pass.recvBuffer + ( mRecvOffsets[chunk.neighbor] + chunk.first ) * pass.ncomp,
+                   static_cast< int >( chunk.last - chunk.first ) * pass.ncomp, MPI_DOUBLE,
+                   mNeighbors[chunk.neighbor].rank, HALO_MPI_TAG + pass.channel, pcomm->comm(), &pass.requests[ic] );
+    }
+
+    // Unpack the chunks whose receive has completed (waiting for at least one if requested)
+    double packTime = 0.0, unpackTime = 0.0;
+    auto unpack_completed = [&]( bool wait ) {
+        int ncompleted = 0;
+        if( wait )
+            MPI_Waitsome( nrecvChunks, pass.requests.data(), &ncompleted, mCompleted.data(), MPI_STATUSES_IGNORE );
+        else
+            MPI_Testsome( nrecvChunks, pass.requests.data(), &ncompleted, mCompleted.data(), MPI_STATUSES_IGNORE );
+        if( ncompleted == MPI_UNDEFINED ) return false;
+        const double tUnpack = MPI_Wtime();
+        long long nbytes     = 0;
+        for( int ic = 0; ic < ncompleted; ++ic )
+        {
+            const Chunk& chunk = mRecvChunks[mCompleted[ic]];
+            unpack_entities( pass, chunk.neighbor, chunk.first, chunk.last,
+                             pass.recvBuffer + ( mRecvOffsets[chunk.neighbor] + chunk.first ) * pass.ncomp );
+            nbytes += ( chunk.last - chunk.first ) * pass.ncomp * sizeof( double );
+        }
+        const double tUnpacked = MPI_Wtime();
+        trace( TraceRecorder::UNPACK, tUnpack, tUnpacked, -1, nbytes );
+        unpackTime += tUnpacked - tUnpack;
+        return true;
+    };
+
+    // Every chunk is sent as soon as it is packed, and the chunks that have arrived in the meantime are
+    // unpacked between the sends
+    for( size_t ic = 0; ic < mSendChunks.size(); ++ic )
+    {
+        const Chunk& chunk  = mSendChunks[ic];
+        const double tPack  = MPI_Wtime();
+        double* const first = pass.sendBuffer + ( mSendOffsets[chunk.neighbor] + chunk.first ) * pass.ncomp;
+        pack_entities( pass, chunk.neighbor, chunk.first, chunk.last, first );
+        MPI_Isend( first, static_cast< int >( chunk.last - chunk.first ) * pass.ncomp, MPI_DOUBLE,
+                   mNeighbors[chunk.neighbor].rank, HALO_MPI_TAG + pass.channel, pcomm->comm(),
+                   &pass.requests[nrecvChunks + ic] );
+        const double tSent = MPI_Wtime();
+        trace( TraceRecorder::PACK, tPack, tSent, mNeighbors[chunk.neighbor].rank,
+               static_cast< long long >( ( chunk.last - chunk.first ) * pass.ncomp * sizeof( double ) ) );
+        packTime += tSent - tPack;
+        unpack_completed( false );
+    }
+    const double tPacked = MPI_Wtime();
+    while( unpack_completed( true ) )
+        ;
+    MPI_Waitall( static_cast< int >( mSendChunks.size() ), pass.requests.data() + nrecvChunks, MPI_STATUSES_IGNORE );
+    const double tEnd = MPI_Wtime();
+    trace( TraceRecorder::WAIT, tPacked, tEnd );
+
+    mPhaseTimes.pack += packTime;
+    mPhaseTimes.unpack += unpackTime;
+    mPhaseTimes.wait += std::max( tEnd - tStart - packTime - unpackTime, 0.0 );
+    mCallTimes.push_back( tEnd - tStart );
+    return moab::MB_SUCCESS;
+}
+
+moab::ErrorCode HaloExchange::replay( const int ncomp, const int nruns )
+{
+    // Allocate and touch the buffers once, outside of the measured iterations
+    std::vector< double > sendBuffer( num_send_entities() * ncomp, 1.0 );
+    std::vector< double > recvBuffer( num_recv_entities() * ncomp, 0.0 );
+    std::vector< MPI_Request > requests;
+    requests.reserve( 2 * mNeighbors.size() );
+
+    for( int irun = 0; irun < nruns; ++irun )
+    {
+        requests.clear();
+        size_t offset = 0;
+        for( auto& nbr : mNeighbors )
+        {
+            const int nvalues = static_cast< int >( nbr.recv_ids.size() ) * ncomp;
+            if( !nvalues ) continue;
+            requests.push_back( MPI_REQUEST_NULL );
+            MPI_Irecv( recvBuffer.data() + offset, nvalues, MPI_DOUBLE, nbr.rank, HALO_MPI_TAG, pcomm->comm(),
+                       &requests.back() );
+            offset += nvalues;
+        }
+        offset = 0;
+        for( auto& nbr : mNeighbors )
+        {
+            const int nvalues = static_cast< int >( nbr.send_ids.size() ) * ncomp;
+            if( !nvalues ) continue;
+            requests.push_back( MPI_REQUEST_NULL );
+            MPI_Isend( sendBuffer.data() + offset, nvalues, MPI_DOUBLE, nbr.rank, HALO_MPI_TAG, pcomm->comm(),
+                       &requests.back() );
+            offset += nvalues;
+        }
+        MPI_Waitall( static_cast< int >( requests.size() ), requests.data(), MPI_STATUSES_IGNORE );
+    }
+
+    return moab::MB_SUCCESS;
+}
+
+void HaloExchange::reserve_buffers( const int ncomp )
+{
+    mBuffers.reserve( SEND_BUFFER, num_send_entities() * ncomp );
+    mBuffers.reserve( RECV_BUFFER, num_recv_entities() * ncomp );
+}
+
+void HaloExchange::reset_timers()
+{
+    mPhaseTimes = PhaseTimes();
+    mCallTimes.clear();
+    mInPlaceBytes  = 0;
+    mReceivedBytes = 0;
+    mBuffers.reset_counts();
+}
+
+size_t HaloExchange::num_send_entities() const
+{
+    size_t count = 0;
+    for( auto& nbr : mNeighbors )
+        count += nbr.send_ids.size();
+    return count;
+}
+
+size_t HaloExchange::num_recv_entities() const
+{
+    size_t count = 0;
+    for( auto& nbr : mNeighbors )
+        count += nbr.recv_ids.size();
+    return count;
+}
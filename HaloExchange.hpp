@@ -0,0 +1,513 @@
+#ifndef __HaloExchange_hpp_
+#define __HaloExchange_hpp_
+
+// MOAB includes
+#include "moab/Core.hpp"
+
+#ifndef MOAB_HAVE_MPI
+#error "Please build MOAB with MPI..."
+#endif
+
+#include "moab/ParallelComm.hpp"
+#include "MBParallelConventions.h"
+
+// Example includes
+#include "BufferPool.hpp"
+#include "PerfCounters.hpp"
+#include "TraceRecorder.hpp"
+
+// C++ includes
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief The HaloExchange is a light-weight, instrumented halo exchange engine that
+/// synchronizes dense double tags from owned entities to their shared/ghost copies.
+/// The communication pattern (neighbor ranks and the ordered per-neighbor send and
+/// receive lists) is computed once from the MOAB sharing data, and every exchange
+/// then only packs, transfers and unpacks tag values directly from dense tag storage.
+/// The time spent in each phase (pack, wait, unpack) is recorded per call so that the
+/// behavior of individual ranks can be analyzed.
+class HaloExchange
+{
+  public:
+    /// @brief Accumulated time spent in each phase of the exchange on this rank
+    struct PhaseTimes
+    {
+        double pack{ 0.0 };    /// packing send buffers and posting the sends
+        double wait{ 0.0 };    /// waiting for the messages to complete
+        double unpack{ 0.0 };  /// unpacking receive buffers into the ghost copies
+
+        double total() const
+        {
+            return pack + wait + unpack;
+        }
+    };
+
+    /// @brief How the owned boundary values are gathered into the messages
+    enum PackStrategy
+    {
+        PACK_BUFFER = 0,   /// explicit copy into a contiguous send buffer
+        PACK_DATATYPE,     /// send directly from tag storage with an MPI derived datatype per neighbor
+        PACK_PARTITIONED,  /// MPI-4 partitioned messages, each partition sent as soon as it is packed
+        PACK_PIPELINED    /// one message per chunk, sent as soon as packed and unpacked as soon as received
+    };
+
+    /// @brief How the contributions of the shared and ghost copies are combined into the owned values
+    enum ReduceOp
+    {
+        REDUCE_SUM = 0,  /// add the contributions to the owned value
+        REDUCE_MIN,      /// keep the smallest of the owned value and the contributions
+        REDUCE_MAX,      /// keep the largest of the owned value and the contributions
+        REDUCE_CUSTOM    /// combine the contributions one by one with a user function
+    };
+
+    /// @brief User function combining a contribution into an owned value (REDUCE_CUSTOM)
+    typedef double ( *ReduceFunction )( double owned, double contribution );
+
+    /// @brief Communication pattern with one neighboring rank
+    struct Neighbor
+    {
+        int rank{ -1 };                         /// neighbor rank in the communicator
+        std::vector< int > send_ids;            /// local indices of owned entities sent to the neighbor
+        std::vector< int > recv_ids;            /// local indices of ghost/shared copies received from the neighbor
+        std::vector< size_t > send_layer_ends;  /// entities of send_ids in ghost layers 0..layer [layer]
+        std::vector< size_t > recv_layer_ends;  /// entities of recv_ids in ghost layers 0..layer [layer]
+    };
+
+    /// @brief Constructor
+    /// @param mbImpl MOAB interface holding the mesh
+    /// @param pcomm Parallel communicator with resolved shared and ghost entities
+    HaloExchange( moab::Interface* mbImpl, moab::ParallelComm* pcomm );
+
+    /// @brief Destructor: release the MPI datatypes (must be called before MPI_Finalize)
+    ~HaloExchange();
+
+    HaloExchange( const HaloExchange& )            = delete;
+    HaloExchange& operator=( const HaloExchange& ) = delete;
+
+    /// @brief Compute the exchange pattern for the given entities
+    /// @param entities All local entities (owned and ghosted) that participate in the exchange
+    /// @param layers Ghost layer of every entity (0 for the owned and shared entities, k for the ghosts
+    ///        created by the k-th layer), given on all the processes to allow exchanges of the first
+    ///        layers only; the send and receive lists are then ordered by the layer on the receiving side
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode setup( const moab::Range& entities, const std::vector< int >& layers = std::vector< int >() );
+
+    /// @brief Number of ghost layers given to setup (0 if the layers are unknown)
+    int num_layers() const
+    {
+        return mNumLayers;
+    }
+
+    /// @brief Update the shared and ghosted copies of a dense double tag with the owned values
+    /// @param tag Dense tag of type MB_TYPE_DOUBLE to exchange
+    /// @param depth Number of ghost layers to update (0 for all); exchanges of fewer layers than given
+    ///        to setup always use pack buffers (PACK_BUFFER, not received in place)
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode exchange( moab::Tag tag, int depth = 0 )
+    {
+        return exchange_tags( &tag, 1, depth );
+    }
+
+    /// @brief Update several dense double tags at once, with one message per neighbor; the values of
+    ///        each tag form a contiguous section of the message, so that a field stored as one tag per
+    ///        level (SoA) is packed level by level and a multi-component tag (AoS) entity by entity
+    /// @param tags Dense tags of type MB_TYPE_DOUBLE to exchange
+    /// @param depth Number of ghost layers to update (0 for all)
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode exchange( const std::vector< moab::Tag >& tags, int depth = 0 )
+    {
+        return exchange_tags( tags.data(), tags.size(), depth );
+    }
+
+    /// @brief Reverse exchange (like ParallelComm::reduce_tags): send the values of the shared and ghost
+    ///        copies of a dense double tag to the owners, and combine them into the owned values. The
+    ///        messages of the neighbors are combined in rank order, so that sums are reproducible. The
+    ///        copies keep their values; a forward exchange afterwards propagates the reduced values
+    /// @param tag Dense tag of type MB_TYPE_DOUBLE to reduce
+    /// @param op Reduction operator
+    /// @param function Combining function of REDUCE_CUSTOM (ignored otherwise)
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode reduce( moab::Tag tag, ReduceOp op, ReduceFunction function = nullptr )
+    {
+        return reduce_tags( &tag, 1, op, function );
+    }
+
+    /// @brief Reduce several dense double tags at once, with one message per neighbor
+    /// @param tags Dense tags of type MB_TYPE_DOUBLE to reduce
+    /// @param op Reduction operator (applied to every component of every tag)
+    /// @param function Combining function of REDUCE_CUSTOM (ignored otherwise)
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode reduce( const std::vector< moab::Tag >& tags, ReduceOp op, ReduceFunction function = nullptr )
+    {
+        return reduce_tags( tags.data(), tags.size(), op, function );
+    }
+
+    /// @brief Start a split-phase exchange of dense double tags: post the receives and pack and send
+    ///        the messages (monolithic messages with pack buffers, or datatypes if selected), and return
+    ///        so that the caller can compute while the messages are in flight. The tag values must not be
+    ///        modified until end_exchange returns. One split-phase exchange can be in progress per channel
+    /// @param tags Dense tags of type MB_TYPE_DOUBLE to exchange
+    /// @param channel Channel of the exchange (0, or a channel returned by open_channel)
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode begin_exchange( const std::vector< moab::Tag >& tags, int channel = 0 );
+
+    /// @brief Test whether the messages of the split-phase exchange of a channel have all arrived
+    ///        (true if no exchange is in progress on the channel, or if the channel does not exist); does not
+    ///        unpack them
+    bool test_exchange( int channel );
+
+    /// @brief Complete the split-phase exchange of a channel: wait for the messages and unpack them
+    /// @param channel Channel of the exchange
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode end_exchange( int channel = 0 );
+
+    /// @brief Open a new channel, so that several split-phase exchanges can be in flight at once. Each
+    ///        channel has its own buffers, requests and MPI tag, so the messages of concurrent exchanges
+    ///        cannot be confused as long as all the processes open their channels in the same order.
+    ///        Channel 0 always exists and is the one of the blocking exchanges
+    /// @return Index of the new channel
+    int open_channel();
+
+    /// @brief Number of channels (including the default channel 0)
+    int num_channels() const
+    {
+        return static_cast< int >( mChannels.size() );
+    }
+
+    /// @brief Start a communication progress thread that drives the split-phase exchanges in flight
+    ///        with MPI_Test, so that they progress while the caller computes. Requires MPI_THREAD_MULTIPLE.
+    ///        The thread only drives channel 0, and sleeps while no exchange is in flight on it. The
+    ///        calling thread may not run on the CPU of the progress thread until it is stopped
+    /// @param cpu CPU to pin the thread to (a spare core or hyperthread), or -1 for the last CPU allowed
+    ///        for the calling thread
+    /// @param pinnedCpu CPU the thread has been pinned to (-1 if it could not be pinned)
+    /// @return False if MPI does not allow the thread to call it, or if the calling thread may only
+    ///         run on the CPU of the progress thread (no thread is started)
+    bool start_progress_thread( int cpu, int& pinnedCpu );
+
+    /// @brief Stop the progress thread, if any
+    void stop_progress_thread();
+
+    /// @brief Replay the communication pattern with raw MPI_Isend/MPI_Irecv on preallocated buffers
+    ///        (no packing or unpacking), as a lower bound for the cost of an exchange
+    /// @param ncomp Number of double components per entity in each message
+    /// @param nruns Number of times to repeat the exchange
+    /// @return Error code if any (else MB_SUCCESS)
+    moab::ErrorCode replay( const int ncomp, const int nruns );
+
+    /// @brief Measure hardware counters around the pack phase of every exchange
+    /// @param counters Counters to accumulate into (nullptr to disable)
+    void set_pack_counters( PerfCounters* counters )
+    {
+        mPackCounters = counters;
+    }
+
+    /// @brief Record the pack, send, wait and unpack events of every exchange
+    /// @param trace Event recorder to use (nullptr to disable)
+    void set_trace( TraceRecorder* trace )
+    {
+        mTrace = trace;
+    }
+
+    /// @brief Select how the send messages are packed
+    /// @param strategy Pack strategy (explicit buffers by default)
+    void set_pack_strategy( PackStrategy strategy )
+    {
+        mPackStrategy = strategy;
+    }
+
+    /// @brief Size of the partitions of the PACK_PARTITIONED strategy: every message is split into
+    ///        partitions of whole entities of about this size, packed by the OpenMP threads and marked
+    ///        ready (MPI_Pready) one by one, while the received partitions are unpacked as soon as they
+    ///        arrive (MPI_Parrived). All the ranks must use the same size
+    /// @param bytes Target partition size in bytes
+    void set_partition_bytes( size_t bytes )
+    {
+        mPartitionBytes = bytes;
+    }
+
+    /// @brief Size of the chunks of the PACK_PIPELINED strategy: every message is split into chunks of
+    ///        whole entities of about this size, each sent as its own message as soon as it is packed
+    ///        (round-robin over the neighbors), while the chunks that have already arrived are unpacked
+    ///        between the sends (MPI_Testsome) and after them (MPI_Waitsome). All the ranks must use
+    ///        the same size
+    /// @param bytes Target chunk size in bytes
+    void set_chunk_bytes( size_t bytes )
+    {
+        mChunkBytes = bytes;
+    }
+
+    /// @brief True if the MPI library supports partitioned communication (MPI-4); otherwise the
+    ///        PACK_PARTITIONED strategy falls back to PACK_BUFFER
+    static bool partitioned_available();
+
+    /// @brief Receive the messages directly into dense tag storage, with no unpacking, whenever the
+    ///        receive list of a neighbor is made of long contiguous runs of ghost storage (as created by
+    ///        exchange_ghost_cells, one run per neighbor and ghost layer); the runs are described by an
+    ///        MPI hindexed datatype built once per neighbor and list of tags
+    /// @param enable True to receive in place when possible
+    void set_receive_in_place( bool enable )
+    {
+        mReceiveInPlace = enable;
+    }
+
+    /// @brief Number of bytes received since the last reset, in total and directly into tag storage
+    void received_bytes( size_t& inPlace, size_t& total ) const
+    {
+        inPlace = mInPlaceBytes;
+        total   = mReceivedBytes;
+    }
+
+    /// @brief Let every OpenMP thread exchange the messages of its own subset of the neighbors (posting,
+    ///        packing, waiting and unpacking concurrently); the neighbors are balanced over the threads by
+    ///        message size. Requires MPI_THREAD_MULTIPLE; the pack counters are not measured in this mode,
+    ///        and the phase times are those of the slowest thread
+    /// @param enable True to exchange with all the threads of the calling process
+    void set_threaded( bool enable )
+    {
+        mThreaded = enable;
+    }
+
+    /// @brief Back the send and receive buffers with transparent huge pages (for buffers of 2 MB or more)
+    void set_huge_pages( bool enable )
+    {
+        mBuffers.set_huge_pages( enable );
+    }
+
+    /// @brief Size the persistent send and receive buffers once from the exchange pattern, so that
+    ///        no exchange of up to ncomp values per entity needs to allocate
+    /// @param ncomp Largest number of values per entity exchanged at once
+    void reserve_buffers( const int ncomp );
+
+    /// @brief Buffer pool holding the send and receive buffers (allocation counts since the last reset)
+    const BufferPool& buffers() const
+    {
+        return mBuffers;
+    }
+
+    /// @brief Reset all accumulated phase timers, per-call timing history and allocation counts
+    void reset_timers();
+
+    /// @brief Accumulated phase times since the last reset
+    const PhaseTimes& phase_times() const
+    {
+        return mPhaseTimes;
+    }
+
+    /// @brief Wall time of every exchange call since the last reset
+    const std::vector< double >& call_times() const
+    {
+        return mCallTimes;
+    }
+
+    /// @brief Neighbor ranks and their send/receive lists
+    const std::vector< Neighbor >& neighbors() const
+    {
+        return mNeighbors;
+    }
+
+    /// @brief Local entities participating in the exchange (indices refer to this range)
+    const moab::Range& entities() const
+    {
+        return mEntities;
+    }
+
+    /// @brief Total number of entity copies sent per exchange (owned boundary size)
+    size_t num_send_entities() const;
+
+    /// @brief Total number of entity copies received per exchange (shared + ghost size)
+    size_t num_recv_entities() const;
+
+  private:
+    /// @brief Pointers into dense tag storage for all the send and receive lists of a tag
+    struct TagBinding
+    {
+        int ncomp{ 0 };
+        std::vector< std::vector< double* > > send_ptrs;  /// [neighbor][entity]
+        std::vector< std::vector< double* > > recv_ptrs;  /// [neighbor][entity]
+    };
+
+    /// @brief Look up (or create) the dense storage binding for a tag
+    moab::ErrorCode bind_tag( moab::Tag tag, TagBinding*& binding );
+
+    /// @brief Exchange a list of tags with one message per neighbor
+    moab::ErrorCode exchange_tags( const moab::Tag* tags, size_t ntags, int depth );
+
+    /// @brief Reduce a list of tags onto the owners with one message per neighbor
+    moab::ErrorCode reduce_tags( const moab::Tag* tags, size_t ntags, ReduceOp op, ReduceFunction function );
+
+    /// @brief Per-neighbor datatypes describing the messages of a list of tags in dense tag storage
+    ///        (MPI_DATATYPE_NULL for the neighbors that are packed or unpacked with buffers)
+    struct TypeSet
+    {
+        std::vector< MPI_Datatype > send;  /// owned boundary values sent to each neighbor
+        std::vector< MPI_Datatype > recv;  /// ghost values received in place from each neighbor
+    };
+
+    /// @brief Look up (or create) the datatypes of the active tags
+    const TypeSet& datatypes( const moab::Tag* tags, size_t ntags, const std::vector< TagBinding* >& active );
+
+    /// @brief Create the datatype of the message to or from a neighbor, made of the runs of contiguous
+    ///        entities of the active tags, or MPI_DATATYPE_NULL if the runs are on average shorter
+    ///        than minRunLength entities
+    MPI_Datatype create_type( const std::vector< TagBinding* >& active, size_t in, bool send,
+                              size_t minRunLength ) const;
+
+    /// @brief Release all the cached datatypes
+    void free_types();
+
+    /// @brief Tags, buffers, datatypes and requests of the exchange in progress on a channel
+    struct Pass
+    {
+        int ncomp{ 0 };                        /// values per entity in every message
+        bool sendTyped{ false };               /// send from tag storage with datatypes
+        double* sendBuffer{ nullptr };         /// packed send messages (buffer strategy)
+        double* recvBuffer{ nullptr };         /// receive messages that are not received in place
+        const TypeSet* types{ nullptr };       /// datatypes of the active tags, if needed
+        bool inPlace{ false };                 /// receive contiguous ghost runs in place
+        PackStrategy strategy{ PACK_BUFFER };  /// strategy used for this exchange
+        double tStart{ 0.0 }, tPacked{ 0.0 };  /// times when the exchange started and was sent
+        std::vector< TagBinding* > active;     /// bindings of the exchanged tags
+        std::vector< MPI_Request > requests;   /// receive [neighbor] and send [nneighbors + neighbor] requests
+        int channel{ 0 };                      /// channel (selects the MPI tag and the buffers)
+        int depth{ 0 };                        /// ghost layers exchanged (0 = all)
+        bool pending{ false };                 /// a split-phase exchange has been started
+    };
+
+    /// @brief Reset the exchange of a channel and bind its tags
+    moab::ErrorCode bind_tags( const moab::Tag* tags, size_t ntags, Pass& pass );
+
+    /// @brief Bind the tags, select the strategy and size the buffers and requests of an exchange
+    moab::ErrorCode prepare( const moab::Tag* tags, size_t ntags, bool splitPhase, int depth, Pass& pass );
+
+    /// @brief Number of entities sent to a neighbor in an exchange (up to its depth)
+    size_t send_count( const Pass& pass, size_t in ) const
+    {
+        return pass.depth ? mNeighbors[in].send_layer_ends[pass.depth] : mNeighbors[in].send_ids.size();
+    }
+
+    /// @brief Number of entities received from a neighbor in an exchange (up to its depth)
+    size_t recv_count( const Pass& pass, size_t in ) const
+    {
+        return pass.depth ? mNeighbors[in].recv_layer_ends[pass.depth] : mNeighbors[in].recv_ids.size();
+    }
+
+    /// @brief Post the receives and pack and send the monolithic messages of an exchange
+    void start( Pass& pass );
+
+    /// @brief Wait for the monolithic messages of an exchange and unpack them
+    void finish( Pass& pass );
+
+    /// @brief Exchange the messages with the neighbors split over the OpenMP threads
+    moab::ErrorCode exchange_threaded( Pass& pass );
+
+    /// @brief Exchange the messages as MPI-4 partitioned messages
+    moab::ErrorCode exchange_partitioned( Pass& pass );
+
+    /// @brief Exchange the messages in chunks, pipelining packing, transfer and unpacking
+    moab::ErrorCode exchange_pipelined( Pass& pass );
+
+    /// @brief Range of entities [first, last) of the send or receive list of a neighbor
+    struct Chunk
+    {
+        size_t neighbor;
+        size_t first, last;
+    };
+
+    /// @brief Split the send and receive lists into chunks of the given number of entities
+    void create_chunks( size_t entities );
+
+    /// @brief Persistent partitioned requests of the messages, for one message layout and pair of buffers
+    struct PartitionSet
+    {
+        int ncomp{ 0 };                                      /// values per entity in every message
+        size_t entities{ 0 };                                /// entities per partition
+        double* send{ nullptr };                             /// send buffer of the requests
+        double* recv{ nullptr };                             /// receive buffer of the requests
+        std::vector< size_t > send_offsets, recv_offsets;    /// padded message offsets [neighbor + 1]
+        std::vector< MPI_Request > requests;                 /// requests of the non-empty messages
+        std::vector< int > send_request, recv_request;       /// request index of every neighbor (or -1)
+        std::vector< std::pair< size_t, int > > send_parts;  /// (neighbor, partition) of every send
+        std::vector< std::pair< size_t, int > > recv_parts;  /// (neighbor, partition) of every receive
+    };
+
+    /// @brief Create the persistent partitioned requests for the message layout of the active tags
+    void create_partitions( int ncomp, size_t entities, double* send, double* recv );
+
+    /// @brief Release the persistent partitioned requests
+    void free_partitions();
+
+    /// @brief Pack the values of entities [first, last) of the send list of a neighbor, tag by tag
+    void pack_entities( const Pass& pass, size_t in, size_t first, size_t last, double* buffer ) const;
+
+    /// @brief Unpack the values of entities [first, last) of the receive list of a neighbor, tag by tag
+    void unpack_entities( const Pass& pass, size_t in, size_t first, size_t last, const double* buffer ) const;
+
+    /// @brief Pack the values of the shared and ghost copies owned by a neighbor, tag by tag (reverse exchange)
+    void pack_copies( const Pass& pass, size_t in, double* buffer ) const;
+
+    /// @brief Combine the contributions received from a neighbor into the owned values, tag by tag
+    void combine_entities( const Pass& pass, size_t in, const double* buffer, ReduceOp op,
+                           ReduceFunction function ) const;
+
+    /// @brief Post the receive of the message from a neighbor
+    void post_receive( const Pass& pass, size_t in, MPI_Request* request );
+
+    /// @brief Pack the message to a neighbor (unless sent with a datatype) and post its send
+    void pack_and_send( const Pass& pass, size_t in, MPI_Request* request );
+
+    /// @brief Scatter the received message of a neighbor into tag storage (unless received in place)
+    void unpack( const Pass& pass, size_t in );
+
+    /// @brief True if the message from a neighbor is received directly into tag storage
+    bool in_place( const Pass& pass, size_t in ) const
+    {
+        return pass.inPlace && pass.types->recv[in] != MPI_DATATYPE_NULL;
+    }
+
+    /// @brief Record a trace event (thread-safe)
+    void trace( TraceRecorder::Phase phase, double begin, double end, int neighbor = -1, long long bytes = 0 );
+
+    moab::Interface* mbImpl;
+    moab::ParallelComm* pcomm;
+
+    moab::Range mEntities;
+    std::vector< Neighbor > mNeighbors;
+    std::vector< size_t > mSendOffsets, mRecvOffsets;       /// message offsets in the buffers [neighbor + 1]
+    int mNumLayers{ 0 };                                    /// ghost layers given to setup (0 if unknown)
+    std::vector< std::vector< size_t > > mThreadNeighbors;  /// neighbors exchanged by each thread
+    std::map< moab::Tag, TagBinding > mBindings;
+    std::map< std::vector< moab::Tag >, TypeSet > mTypes;
+    PartitionSet mPartitions;
+    size_t mChunkEntities{ 0 };                     /// entities per chunk of the current chunk lists
+    std::vector< Chunk > mSendChunks, mRecvChunks;  /// chunks in the order they are sent and received
+    std::vector< int > mCompleted;                  /// indices of the completed chunk receives
+
+    BufferPool mBuffers;           /// send and receive buffers of every channel [2 * channel + 0/1]
+    std::deque< Pass > mChannels;  /// exchange of every channel (stable addresses as channels are added)
+    std::thread mProgressThread;
+    std::atomic< bool > mProgressRunning{ false };  /// the progress thread keeps running
+    std::atomic< bool > mInFlight{ false };         /// the progress thread owns the requests of channel 0
+    std::mutex mProgressMutex;                      /// guards the changes of the two flags above
+    std::condition_variable mProgressChanged;       /// signals the changes of the two flags above
+    std::vector< int > mCallerCpus;                 /// CPUs of the caller before the progress thread started
+
+    PhaseTimes mPhaseTimes;
+    PerfCounters* mPackCounters{ nullptr };
+    TraceRecorder* mTrace{ nullptr };
+    PackStrategy mPackStrategy{ PACK_BUFFER };
+    bool mReceiveInPlace{ false };
+    bool mThreaded{ false };
+    size_t mPartitionBytes{ 64 * 1024 };
+    size_t mChunkBytes{ 64 * 1024 };
+    size_t mInPlaceBytes{ 0 }, mReceivedBytes{ 0 };
+    std::vector< double > mCallTimes;
+};
+
+#endif  // #ifndef __HaloExchange_hpp_
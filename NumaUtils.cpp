@@ -0,0 +1,137 @@
+// Example Includes
+#include "NumaUtils.hpp"
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// C++ includes
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace NumaUtils
+{
+/// @brief Page size of the system
+static size_t page_bytes()
+{
+#ifdef __linux__
+    static const size_t bytes = static_cast< size_t >( sysconf( _SC_PAGESIZE ) );
+    return bytes;
+#else
+    return 4096;
+#endif
+}
+
+/// @brief First page and number of pages covering a region, or only the whole pages inside the
+///        region (inward)
+static void page_range( const Region& region, uintptr_t& first, size_t& npages, const bool inward = false )
+{
+    const size_t page     = page_bytes();
+    const uintptr_t begin = reinterpret_cast< uintptr_t >( region.data );
+    const uintptr_t last  = begin + region.bytes;
+    first                 = inward ? ( begin + page - 1 ) / page * page : begin / page * page;
+    const uintptr_t end   = inward ? last / page * page : ( last + page - 1 ) / page * page;
+    npages                = region.bytes && end > first ? ( end - first ) / page : 0;
+}
+
+int num_nodes()
+{
+    // The online nodes are listed as ranges, e.g. "0-1" or "0,2-3"; the highest node id is enough
+    static int nodes = -1;
+    if( nodes > 0 ) return nodes;
+    nodes = 1;
+    std::ifstream online( "/sys/devices/system/node/online" );
+    std::string list;
+    if( online >> list )
+    {
+        size_t start = list.find_last_of( ",-" );
+        try
+        {
+            nodes = std::stoi( list.substr( start == std::string::npos ? 0 : start + 1 ) ) + 1;
+        }
+        catch( ... )
+        {
+            nodes = 1;
+        }
+    }
+    return nodes;
+}
+
+int current_node()
+{
+#if defined( __linux__ ) && defined( SYS_getcpu )
+    unsigned cpu = 0, node = 0;
+    if( syscall( SYS_getcpu, &cpu, &node, nullptr ) == 0 ) return static_cast< int >( node );
+#endif
+    return -1;
+}
+
+bool page_nodes( const std::vector< Region >& regions, std::vector< size_t >& pagesPerNode )
+{
+    pagesPerNode.assign( num_nodes(), 0 );
+#if defined( __linux__ ) && defined( SYS_move_pages )
+    // Query in batches: with no destination nodes, move_pages only reports the node of every page
+    const size_t batch = 4096;
+    std::vector< void* > pages( batch );
+    std::vector< int > status( batch );
+    for( auto& region : regions )
+    {
+        uintptr_t first = 0;
+        size_t npages   = 0;
+        page_range( region, first, npages );
+        for( size_t offset = 0; offset < npages; offset += batch )
+        {
+            const size_t count = std::min( batch, npages - offset );
+            for( size_t ip = 0; ip < count; ++ip )
+                pages[ip] = reinterpret_cast< void* >( first + ( offset + ip ) * page_bytes() );
+            if( syscall( SYS_move_pages, 0, count, pages.data(), nullptr, status.data(), 0 ) != 0 ) return false;
+            for( size_t ip = 0; ip < count; ++ip )
+                if( status[ip] >= 0 && status[ip] < static_cast< int >( pagesPerNode.size() ) )
+                    ++pagesPerNode[status[ip]];
+        }
+    }
+    return true;
+#else
+    (void)regions;
+    return false;
+#endif
+}
+
+bool move_to_node( const std::vector< Region >& regions, int node, size_t& edgePages )
+{
+    edgePages = 0;
+#if defined( __linux__ ) && defined( SYS_mbind )
+    if( node < 0 || node >= num_nodes() ) return false;
+    unsigned long mask[16] = { 0 };
+    const unsigned long maxNode = 8 * sizeof( mask );
+    if( static_cast< unsigned long >( node ) >= maxNode ) return false;
+    mask[node / ( 8 * sizeof( unsigned long ) )] = 1UL << ( node % ( 8 * sizeof( unsigned long ) ) );
+
+    bool ok = true;
+    for( auto& region : regions )
+    {
+        // Only the whole pages of the region are bound: the policy (and the migration) of a page
+        // shared with neighboring heap allocations would also apply to them
+        uintptr_t first = 0;
+        size_t npages = 0, coveringPages = 0;
+        page_range( region, first, coveringPages );
+        page_range( region, first, npages, true );
+        edgePages += coveringPages - npages;
+        if( !npages ) continue;
+        // MPOL_PREFERRED falls back to other nodes when the local node is full, and MPOL_MF_MOVE
+        // migrates the pages that are already resident on another node
+        ok &= syscall( SYS_mbind, reinterpret_cast< void* >( first ), npages * page_bytes(), MPOL_PREFERRED, mask,
+                       maxNode, MPOL_MF_MOVE ) == 0;
+    }
+    return ok;
+#else
+    (void)regions;
+    (void)node;
+    return false;
+#endif
+}
+}  // namespace NumaUtils
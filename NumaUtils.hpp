@@ -0,0 +1,45 @@
+#ifndef __NumaUtils_hpp_
+#define __NumaUtils_hpp_
+
+// C++ includes
+#include <cstddef>
+#include <vector>
+
+/// @brief Minimal NUMA utilities based on the Linux system calls (get_mempolicy family), so
+/// that no libnuma is needed: query the node of the calling thread, count the pages of a memory
+/// region on every node (move_pages query mode) and migrate a region to a node (mbind). On
+/// non-Linux systems, or when the calls are not permitted, the functions report a single node
+/// and leave the memory untouched.
+namespace NumaUtils
+{
+/// @brief Memory region (any alignment)
+struct Region
+{
+    const void* data;
+    size_t bytes;
+};
+
+/// @brief Number of NUMA nodes of the system (1 if unknown)
+int num_nodes();
+
+/// @brief NUMA node of the CPU running the calling thread (-1 if unknown)
+int current_node();
+
+/// @brief Count the resident pages of the regions on every node
+/// @param regions Memory regions to query
+/// @param pagesPerNode Number of pages on each node [num_nodes()]; pages that are not
+///        resident (never touched) or cannot be queried are not counted
+/// @return False if the placement cannot be queried on this system
+bool page_nodes( const std::vector< Region >& regions, std::vector< size_t >& pagesPerNode );
+
+/// @brief Migrate the pages of the regions to a node and prefer that node for the pages
+///        allocated later in the regions. Only the whole pages inside every region are bound and
+///        moved, so that neighboring allocations sharing its first or last page are left untouched
+/// @param regions Memory regions to migrate
+/// @param node Destination node
+/// @param edgePages Number of partially covered pages at the edges of the regions (not moved)
+/// @return False if a region could not be migrated
+bool move_to_node( const std::vector< Region >& regions, int node, size_t& edgePages );
+}  // namespace NumaUtils
+
+#endif  // #ifndef __NumaUtils_hpp_
@@ -0,0 +1,122 @@
+// Example Includes
+#include "PerfCounters.hpp"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// C++ includes
+#include <cstring>
+
+PerfCounters::PerfCounters( bool allThreads ) : mAllThreads( allThreads )
+{
+    reset();
+}
+
+PerfCounters::~PerfCounters()
+{
+#ifdef __linux__
+    for( int fd : mFileDescriptors )
+        if( fd >= 0 ) close( fd );
+#endif
+}
+
+const char* PerfCounters::name( Event event )
+{
+    static const char* names[NUM_EVENTS] = { "cycles", "instructions", "LLC misses", "dTLB misses" };
+    return names[event];
+}
+
+bool PerfCounters::open()
+{
+    if( mOpened ) return mAvailable;
+    mOpened = true;
+
+#ifdef __linux__
+    const uint32_t types[NUM_EVENTS]  = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                          PERF_TYPE_HW_CACHE };
+    const uint64_t configs[NUM_EVENTS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+        PERF_COUNT_HW_CACHE_DTLB | ( PERF_COUNT_HW_CACHE_OP_READ << 8 ) | ( PERF_COUNT_HW_CACHE_RESULT_MISS << 16 ) };
+
+    // Every thread of the pool opens the events of its own thread: the counts of inherited events are
+    // only folded into the parent when the child exits, which the threads of the pool never do
+    int nthreads = 1;
+#ifdef _OPENMP
+    if( mAllThreads ) nthreads = omp_get_max_threads();
+#endif
+    mFileDescriptors.assign( static_cast< size_t >( nthreads ) * NUM_EVENTS, -1 );
+#pragma omp parallel num_threads( nthreads ) if( nthreads > 1 )
+    {
+        int ithread = 0;
+#ifdef _OPENMP
+        ithread = omp_get_thread_num();
+#endif
+        for( int ie = 0; ie < NUM_EVENTS; ++ie )
+        {
+            struct perf_event_attr attr;
+            std::memset( &attr, 0, sizeof( attr ) );
+            attr.size           = sizeof( attr );
+            attr.type           = types[ie];
+            attr.config         = configs[ie];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+            // counters run continuously for this thread on any cpu; regions are measured as deltas
+            mFileDescriptors[ithread * NUM_EVENTS + ie] =
+                static_cast< int >( syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 ) );
+        }
+    }
+    // An event is available if the calling thread could open it
+    for( int ie = 0; ie < NUM_EVENTS; ++ie )
+        mAvailable |= ( mFileDescriptors[ie] >= 0 );
+#endif
+    return mAvailable;
+}
+
+void PerfCounters::read_values( double* values ) const
+{
+    for( int ie = 0; ie < NUM_EVENTS; ++ie )
+        values[ie] = 0.0;
+#ifdef __linux__
+    // The events of every thread can be read from the calling thread
+    for( size_t ifd = 0; ifd < mFileDescriptors.size(); ++ifd )
+    {
+        if( mFileDescriptors[ifd] < 0 || mFileDescriptors[ifd % NUM_EVENTS] < 0 ) continue;
+        // [value, time enabled, time running]: scale the value if the counter was multiplexed
+        uint64_t data[3] = { 0, 0, 0 };
+        if( read( mFileDescriptors[ifd], data, sizeof( data ) ) != static_cast< ssize_t >( sizeof( data ) ) )
+            continue;
+        values[ifd % NUM_EVENTS] += ( data[2] > 0 && data[2] < data[1] )
+                                        ? static_cast< double >( data[0] ) * data[1] / data[2]
+                                        : static_cast< double >( data[0] );
+    }
+#endif
+}
+
+void PerfCounters::start()
+{
+    open();
+    read_values( mStartValues );
+}
+
+void PerfCounters::stop()
+{
+    double values[NUM_EVENTS];
+    read_values( values );
+    for( int ie = 0; ie < NUM_EVENTS; ++ie )
+        mCounts[ie] += values[ie] - mStartValues[ie];
+}
+
+void PerfCounters::reset()
+{
+    for( int ie = 0; ie < NUM_EVENTS; ++ie )
+        mStartValues[ie] = mCounts[ie] = 0.0;
+}
@@ -0,0 +1,83 @@
+#ifndef __PerfCounters_hpp_
+#define __PerfCounters_hpp_
+
+// C++ includes
+#include <cstdint>
+#include <vector>
+
+/// @brief The PerfCounters is a minimal wrapper around the Linux perf_event_open
+/// interface to measure hardware performance counters (cycles, instructions,
+/// last-level cache misses and data TLB misses) around a region of code, summed
+/// over the calling thread and, optionally, the threads of its OpenMP pool (a perf
+/// event only counts one thread, so every pool thread opens its own events). No
+/// external dependency (PAPI etc) is needed. On systems
+/// where the counters are not accessible (non-Linux, restricted perf_event_paranoid,
+/// virtual machines without a PMU), the events are simply marked unavailable.
+class PerfCounters
+{
+  public:
+    /// @brief Hardware events that are measured
+    enum Event
+    {
+        CYCLES = 0,
+        INSTRUCTIONS,
+        LLC_MISSES,
+        DTLB_MISSES,
+        NUM_EVENTS
+    };
+
+    /// @brief Constructor
+    /// @param allThreads Also count the threads of the OpenMP pool (else the calling thread only)
+    explicit PerfCounters( bool allThreads = true );
+    ~PerfCounters();
+
+    PerfCounters( const PerfCounters& )            = delete;
+    PerfCounters& operator=( const PerfCounters& ) = delete;
+
+    /// @brief Open the counters for the calling thread and the OpenMP pool (called lazily by start)
+    /// @return True if at least one of the events is available
+    bool open();
+
+    /// @brief Start measuring a region
+    void start();
+
+    /// @brief Stop measuring a region and accumulate the counts
+    void stop();
+
+    /// @brief Clear the accumulated counts
+    void reset();
+
+    /// @brief Check whether an event could be opened on this system
+    bool available( Event event ) const
+    {
+        return !mFileDescriptors.empty() && mFileDescriptors[event] >= 0;
+    }
+
+    /// @brief Number of threads counted
+    int num_threads() const
+    {
+        return static_cast< int >( mFileDescriptors.size() ) / NUM_EVENTS;
+    }
+
+    /// @brief Accumulated count of an event since the last reset
+    double count( Event event ) const
+    {
+        return mCounts[event];
+    }
+
+    /// @brief Human readable name of an event
+    static const char* name( Event event );
+
+  private:
+    /// @brief Read the current (multiplexing corrected) values of all events
+    void read_values( double* values ) const;
+
+    bool mAllThreads;
+    bool mOpened{ false };
+    bool mAvailable{ false };
+    std::vector< int > mFileDescriptors;  /// [thread * NUM_EVENTS + event], -1 if not available
+    double mStartValues[NUM_EVENTS];
+    double mCounts[NUM_EVENTS];
+};
+
+#endif  // #ifndef __PerfCounters_hpp_
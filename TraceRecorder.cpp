@@ -0,0 +1,120 @@
+// Example Includes
+#include "TraceRecorder.hpp"
+
+// C++ includes
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+void TraceRecorder::enable( size_t capacity )
+{
+    mEvents.assign( std::max( capacity, size_t( 1 ) ), Event() );
+    mHead     = 0;
+    mRecorded = 0;
+}
+
+const char* TraceRecorder::name( int phase )
+{
+    static const char* names[NUM_PHASES] = { "read mesh", "ghost setup", "tag creation",
+                                             "exchange_tags", "halo exchange", "pack",
+                                             "send", "wait", "unpack" };
+    return ( phase >= 0 && phase < NUM_PHASES ) ? names[phase] : "unknown";
+}
+
+std::vector< TraceRecorder::Event > TraceRecorder::ordered_events() const
+{
+    std::vector< Event > events;
+    if( mRecorded < mEvents.size() )
+        events.assign( mEvents.begin(), mEvents.begin() + mRecorded );
+    else
+    {
+        // the buffer wrapped around: the oldest event is at the head
+        events.assign( mEvents.begin() + mHead, mEvents.end() );
+        events.insert( events.end(), mEvents.begin(), mEvents.begin() + mHead );
+    }
+    return events;
+}
+
+double TraceRecorder::clock_offset( MPI_Comm comm ) const
+{
+    // All ranks leave a barrier at (nearly) the same instant: the difference between the local
+    // and root timestamps taken right after it estimates the clock offset. Use the median over
+    // several rounds to filter out the rounds where a rank was delayed.
+    const int nrounds = 9;
+    std::vector< double > localTimes( nrounds ), rootTimes( nrounds );
+    for( int iround = 0; iround < nrounds; ++iround )
+    {
+        MPI_Barrier( comm );
+        localTimes[iround] = now();
+    }
+    rootTimes = localTimes;
+    MPI_Bcast( rootTimes.data(), nrounds, MPI_DOUBLE, 0, comm );
+
+    std::vector< double > offsets( nrounds );
+    for( int iround = 0; iround < nrounds; ++iround )
+        offsets[iround] = localTimes[iround] - rootTimes[iround];
+    std::nth_element( offsets.begin(), offsets.begin() + nrounds / 2, offsets.end() );
+    return offsets[nrounds / 2];
+}
+
+bool TraceRecorder::write_chrome_trace( const std::string& filename, MPI_Comm comm ) const
+{
+    int rank = 0, nprocs = 1;
+    MPI_Comm_rank( comm, &rank );
+    MPI_Comm_size( comm, &nprocs );
+
+    // Shift all the events onto the root clock
+    const double offset         = clock_offset( comm );
+    std::vector< Event > events = ordered_events();
+    for( auto& event : events )
+    {
+        event.begin -= offset;
+        event.end -= offset;
+    }
+    double localStart = events.empty() ? 1e300 : events.front().begin, globalStart = 0.0;
+    MPI_Allreduce( &localStart, &globalStart, 1, MPI_DOUBLE, MPI_MIN, comm );
+
+    // The root receives and writes the events one rank at a time to bound its memory usage
+    int ok = 1;
+    if( rank != 0 )
+    {
+        int nevents = static_cast< int >( events.size() );
+        MPI_Send( &nevents, 1, MPI_INT, 0, 0, comm );
+        MPI_Send( events.data(), static_cast< int >( nevents * sizeof( Event ) ), MPI_BYTE, 0, 0, comm );
+    }
+    else
+    {
+        std::ofstream trace( filename.c_str() );
+        ok = trace.good() ? 1 : 0;
+        trace << std::fixed << std::setprecision( 3 ) << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+        bool first = true;
+        for( int iproc = 0; iproc < nprocs; ++iproc )
+        {
+            if( iproc > 0 )
+            {
+                int nevents = 0;
+                MPI_Recv( &nevents, 1, MPI_INT, iproc, 0, comm, MPI_STATUS_IGNORE );
+                events.resize( nevents );
+                MPI_Recv( events.data(), static_cast< int >( nevents * sizeof( Event ) ), MPI_BYTE, iproc, 0, comm,
+                          MPI_STATUS_IGNORE );
+            }
+            if( !first ) trace << ",\n";
+            first = false;
+            trace << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << iproc
+                  << ", \"args\": {\"name\": \"rank " << iproc << "\"}}";
+            for( auto& event : events )
+            {
+                // complete ("X") events in microseconds relative to the earliest event
+                trace << ",\n{\"name\": \"" << name( event.phase ) << "\", \"ph\": \"X\", \"pid\": " << iproc
+                      << ", \"tid\": " << event.thread << ", \"ts\": " << ( event.begin - globalStart ) * 1e6
+                      << ", \"dur\": " << ( event.end - event.begin ) * 1e6 << ", \"args\": {";
+                if( event.neighbor >= 0 ) trace << "\"neighbor\": " << event.neighbor << ", ";
+                trace << "\"bytes\": " << event.bytes << "}}";
+            }
+        }
+        trace << "\n]}\n";
+        ok = ( ok && trace.good() ) ? 1 : 0;
+    }
+    MPI_Bcast( &ok, 1, MPI_INT, 0, comm );
+    return ok != 0;
+}
@@ -0,0 +1,113 @@
+#ifndef __TraceRecorder_hpp_
+#define __TraceRecorder_hpp_
+
+// MPI includes
+#include <mpi.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// C++ includes
+#include <string>
+#include <vector>
+
+/// @brief The TraceRecorder is a low-overhead per-rank event recorder. Events (begin and
+/// end timestamps, phase, neighbor rank and byte count) are stored in a fixed-size ring
+/// buffer so that recording never allocates, and the oldest events are overwritten when
+/// the buffer is full. At the end of the run, the events of all ranks are written by the
+/// root into a single Chrome trace JSON file (chrome://tracing or ui.perfetto.dev) with one
+/// process per rank and one track per OpenMP thread, after aligning the clocks of all ranks
+/// with a barrier-based offset.
+class TraceRecorder
+{
+  public:
+    /// @brief Phases that can be recorded
+    enum Phase
+    {
+        READ_MESH = 0,   /// load the input mesh
+        GHOST_SETUP,     /// create the ghost layers
+        TAG_CREATION,    /// create and initialize the tags
+        EXCHANGE_TAGS,   /// one ParallelComm::exchange_tags iteration
+        HALO_EXCHANGE,   /// one HaloExchange::exchange iteration
+        PACK,            /// pack the message for a neighbor
+        SEND,            /// post the send to a neighbor
+        WAIT,            /// wait for all messages
+        UNPACK,          /// unpack the message from a neighbor
+        NUM_PHASES
+    };
+
+    /// @brief Recorded event
+    struct Event
+    {
+        double begin;     /// start time (MPI_Wtime, local clock)
+        double end;       /// end time (MPI_Wtime, local clock)
+        int phase;        /// Phase identifier
+        int neighbor;     /// neighbor rank (-1 if not applicable)
+        int thread;       /// OpenMP thread that recorded the event (0 outside parallel regions)
+        long long bytes;  /// message size in bytes (0 if not applicable)
+    };
+
+    /// @brief Start recording events into a ring buffer of the given capacity
+    /// @param capacity Maximum number of events kept per rank
+    void enable( size_t capacity );
+
+    /// @brief Check whether events are being recorded
+    bool enabled() const
+    {
+        return !mEvents.empty();
+    }
+
+    /// @brief Current time on the clock used for the events
+    static double now()
+    {
+        return MPI_Wtime();
+    }
+
+    /// @brief Record an event that has already completed
+    inline void record( Phase phase, double begin, double end, int neighbor = -1, long long bytes = 0 )
+    {
+        if( mEvents.empty() ) return;
+        Event& event = mEvents[mHead];
+        event.begin    = begin;
+        event.end      = end;
+        event.phase    = phase;
+        event.neighbor = neighbor;
+        event.bytes    = bytes;
+#ifdef _OPENMP
+        event.thread = omp_get_thread_num();
+#else
+        event.thread = 0;
+#endif
+        if( ++mHead == mEvents.size() ) mHead = 0;
+        ++mRecorded;
+    }
+
+    /// @brief Record an event that started at begin and ends now
+    inline void record_since( Phase phase, double begin, int neighbor = -1, long long bytes = 0 )
+    {
+        if( !mEvents.empty() ) record( phase, begin, now(), neighbor, bytes );
+    }
+
+    /// @brief Write the events of all ranks into a Chrome trace JSON file (collective)
+    /// @param filename Output file name (written by the root process)
+    /// @param comm Communicator of all the ranks that recorded events
+    /// @return True if the file was written successfully
+    bool write_chrome_trace( const std::string& filename, MPI_Comm comm ) const;
+
+    /// @brief Human readable name of a phase
+    static const char* name( int phase );
+
+  private:
+    /// @brief Estimate the offset of the local clock relative to the root clock (collective)
+    double clock_offset( MPI_Comm comm ) const;
+
+    /// @brief Copy the events in chronological order (oldest first)
+    std::vector< Event > ordered_events() const;
+
+    std::vector< Event > mEvents;
+    size_t mHead{ 0 };
+    size_t mRecorded{ 0 };
+};
+
+#endif  // #ifndef __TraceRecorder_hpp_